@@ -0,0 +1,307 @@
+#include "dict.h"
+#include "json.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        size_t HashKey(std::string_view key)
+        {
+            return std::hash<std::string_view>{}(key);
+        }
+
+        bool KeyLess(const Dict::value_type &lhs, const Dict::value_type &rhs)
+        {
+            return lhs.first < rhs.first;
+        }
+
+        // Key и Node перемещаются копированием представления (см. их конструкторы перемещения),
+        // поэтому пары сдвигаются одним memmove, а не поэлементным присваиванием с Release
+        void InsertAt(Dict::Entries &entries, size_t pos, Dict::value_type entry)
+        {
+            // Пустая пара в конце ничем не владеет, и её байты можно затереть
+            entries.emplace_back();
+            Dict::value_type *data = entries.data();
+            std::memmove(static_cast<void *>(data + pos + 1), data + pos, (entries.size() - 1 - pos) * sizeof(Dict::value_type));
+            new (data + pos) Dict::value_type(move(entry));
+        }
+
+        void EraseAt(Dict::Entries &entries, size_t pos)
+        {
+            Dict::value_type *data = entries.data();
+            data[pos].~pair();
+            std::memmove(static_cast<void *>(data + pos), data + pos + 1, (entries.size() - 1 - pos) * sizeof(Dict::value_type));
+            new (data + entries.size() - 1) Dict::value_type();
+            entries.pop_back();
+        }
+
+    } // namespace
+
+    Dict::Dict(std::pmr::memory_resource *resource)
+        : entries_(resource), index_(resource) {}
+
+    Dict::Dict(std::initializer_list<value_type> entries, std::pmr::memory_resource *resource)
+        : Dict(Entries(entries, resource)) {}
+
+    Dict::Dict(Entries entries)
+        : entries_(move(entries)), index_(entries_.get_allocator().resource())
+    {
+        // Устойчивая сортировка сохраняет первым тот из одинаковых ключей, что встретился раньше.
+        // Небольшие словари сортируются вставками, которым не нужен временный буфер
+        if (entries_.size() <= kIndexThreshold)
+        {
+            for (auto it = entries_.begin(); it != entries_.end(); ++it)
+            {
+                std::rotate(std::upper_bound(entries_.begin(), it, *it, KeyLess), it, it + 1);
+            }
+        }
+        else
+        {
+            std::stable_sort(entries_.begin(), entries_.end(), KeyLess);
+        }
+        auto last = std::unique(entries_.begin(), entries_.end(), [](const value_type &lhs, const value_type &rhs)
+                                { return lhs.first == rhs.first; });
+        entries_.erase(last, entries_.end());
+        RebuildIndex();
+    }
+
+    size_t Dict::size() const
+    {
+        return entries_.size();
+    }
+
+    bool Dict::empty() const
+    {
+        return entries_.empty();
+    }
+
+    Dict::const_iterator Dict::begin() const
+    {
+        return entries_.begin();
+    }
+
+    Dict::const_iterator Dict::end() const
+    {
+        return entries_.end();
+    }
+
+    Dict::const_iterator Dict::cbegin() const
+    {
+        return entries_.cbegin();
+    }
+
+    Dict::const_iterator Dict::cend() const
+    {
+        return entries_.cend();
+    }
+
+    Dict::const_iterator Dict::find(std::string_view key) const
+    {
+        if (entries_.size() <= kLinearThreshold)
+        {
+            // В совсем маленьком словаре дешевле сравнить ключи на равенство подряд:
+            // строки разной длины отсекаются без чтения символов
+            return std::find_if(entries_.begin(), entries_.end(), [key](const value_type &entry)
+                                { return entry.first.size() == key.size() && entry.first == key; });
+        }
+        if (index_.empty())
+        {
+            const size_t pos = LowerBound(key);
+            if (pos < entries_.size() && entries_[pos].first == key)
+            {
+                return entries_.begin() + pos;
+            }
+            return entries_.end();
+        }
+        // Линейное пробирование; размер таблицы - степень двойки, и она заполнена не больше чем наполовину
+        const size_t mask = index_.size() - 1;
+        for (size_t slot = HashKey(key) & mask; index_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            const auto &entry = entries_[index_[slot] - 1];
+            if (entry.first == key)
+            {
+                return entries_.begin() + (index_[slot] - 1);
+            }
+        }
+        return entries_.end();
+    }
+
+    size_t Dict::count(std::string_view key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    const Node &Dict::at(std::string_view key) const
+    {
+        const auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("Dict::at");
+        }
+        return it->second;
+    }
+
+    Node &Dict::at(std::string_view key)
+    {
+        const auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("Dict::at");
+        }
+        return entries_[static_cast<size_t>(it - entries_.cbegin())].second;
+    }
+
+    Node &Dict::operator[](std::string_view key)
+    {
+        const auto it = find(key);
+        if (it != end())
+        {
+            return entries_[static_cast<size_t>(it - entries_.cbegin())].second;
+        }
+        const auto inserted = insert({Key(key), Node()}).first;
+        return entries_[static_cast<size_t>(inserted - entries_.cbegin())].second;
+    }
+
+    std::pair<Dict::const_iterator, bool> Dict::insert(value_type entry)
+    {
+        const size_t pos = LowerBound(entry.first);
+        if (pos < entries_.size() && entries_[pos].first == entry.first)
+        {
+            return {entries_.begin() + pos, false};
+        }
+        InsertAt(entries_, pos, move(entry));
+        if (index_.empty() || entries_.size() * 2 > index_.size())
+        {
+            // Таблица заполнилась бы больше чем наполовину: строится вдвое большая
+            RebuildIndex();
+        }
+        else
+        {
+            // Вставка сдвинула номера следующих элементов, а хешируется только новый ключ
+            for (uint32_t &stored : index_)
+            {
+                stored += stored > pos ? 1 : 0;
+            }
+            const size_t mask = index_.size() - 1;
+            size_t slot = HashKey(entries_[pos].first) & mask;
+            while (index_[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            index_[slot] = static_cast<uint32_t>(pos + 1);
+        }
+        return {entries_.begin() + pos, true};
+    }
+
+    std::pair<Dict::const_iterator, bool> Dict::emplace(Key key, Node value)
+    {
+        return insert({move(key), move(value)});
+    }
+
+    size_t Dict::erase(std::string_view key)
+    {
+        const auto it = find(key);
+        if (it == end())
+        {
+            return 0;
+        }
+        const size_t pos = static_cast<size_t>(it - entries_.cbegin());
+        if (index_.empty() || entries_.size() <= kIndexThreshold)
+        {
+            entries_.erase(it);
+            RebuildIndex();
+            return 1;
+        }
+        EraseFromIndex(pos);
+        EraseAt(entries_, pos);
+        for (uint32_t &stored : index_)
+        {
+            stored -= stored > pos + 1 ? 1 : 0;
+        }
+        return 1;
+    }
+
+    Dict::allocator_type Dict::get_allocator() const
+    {
+        return entries_.get_allocator();
+    }
+
+    size_t Dict::GetBufferBytes() const
+    {
+        return entries_.capacity() * sizeof(value_type) + index_.capacity() * sizeof(uint32_t);
+    }
+
+    bool Dict::operator==(const Dict &rhs) const
+    {
+        return entries_ == rhs.entries_;
+    }
+
+    bool Dict::operator!=(const Dict &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    size_t Dict::LowerBound(std::string_view key) const
+    {
+        const auto it = std::lower_bound(entries_.begin(), entries_.end(), key, [](const value_type &entry, std::string_view key)
+                                         { return entry.first < key; });
+        return static_cast<size_t>(it - entries_.begin());
+    }
+
+    // Удаление из таблицы с линейным пробированием без меток удалённых ячеек: элементы
+    // цепочки за освободившейся ячейкой сдвигаются в неё, если она не раньше их родной ячейки
+    void Dict::EraseFromIndex(size_t pos)
+    {
+        const size_t mask = index_.size() - 1;
+        size_t hole = HashKey(entries_[pos].first) & mask;
+        while (index_[hole] != pos + 1)
+        {
+            hole = (hole + 1) & mask;
+        }
+        for (size_t slot = (hole + 1) & mask; index_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            const size_t home = HashKey(entries_[index_[slot] - 1].first) & mask;
+            if (((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                index_[hole] = index_[slot];
+                hole = slot;
+            }
+        }
+        index_[hole] = 0;
+    }
+
+    void Dict::RebuildIndex()
+    {
+        index_.clear();
+        if (entries_.size() < kIndexThreshold)
+        {
+            index_.shrink_to_fit();
+            return;
+        }
+        size_t capacity = 1;
+        while (capacity < entries_.size() * 2)
+        {
+            capacity *= 2;
+        }
+        index_.assign(capacity, 0);
+        const size_t mask = capacity - 1;
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            size_t slot = HashKey(entries_[i].first) & mask;
+            while (index_[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            index_[slot] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+} // namespace json
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "key.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace json
+{
+    class Node;
+
+    // Словарь JSON-объекта. Пары хранятся в одном векторе, отсортированном по ключу,
+    // поэтому обход идёт в том же порядке, что и у std::map. До kLinearThreshold элементов
+    // ключ ищется перебором, до kIndexThreshold - бинарным поиском, а для больших словарей строится хеш-индекс
+    // с открытой адресацией. Вставка и удаление стоят O(n), как и у любого плоского контейнера:
+    // сдвигаются пары и номера в индексе, но хешируется только изменённый ключ.
+    // Поэтому большие словари выгоднее собирать целиком конструктором из вектора пар
+    class Dict
+    {
+    public:
+        using key_type = Key;
+        using mapped_type = Node;
+        using value_type = std::pair<Key, Node>;
+        using size_type = size_t;
+        using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+        using Entries = std::pmr::vector<value_type>;
+        // Ключи менять нельзя, поэтому наружу выдаются только константные итераторы
+        using const_iterator = Entries::const_iterator;
+        using iterator = const_iterator;
+
+        static constexpr size_t kLinearThreshold = 8;
+        static constexpr size_t kIndexThreshold = 16;
+
+        Dict() = default;
+        explicit Dict(std::pmr::memory_resource *resource);
+        Dict(std::initializer_list<value_type> entries, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+        // Сортирует пары по ключу; из повторяющихся ключей остаётся первый, как при std::map::insert
+        explicit Dict(Entries entries);
+
+        Dict(const Dict &) = default;
+        Dict(Dict &&) = default;
+        Dict &operator=(const Dict &) = default;
+        Dict &operator=(Dict &&) = default;
+
+        size_t size() const;
+        bool empty() const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator cbegin() const;
+        const_iterator cend() const;
+
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        // Как и std::map::at, бросает std::out_of_range, если ключа нет
+        const Node &at(std::string_view key) const;
+        Node &at(std::string_view key);
+        // Как и у std::map, для отсутствующего ключа вставляет null
+        Node &operator[](std::string_view key);
+        // Возвращает число удалённых пар: 0 или 1
+        size_t erase(std::string_view key);
+
+        // Как и у std::map, существующее значение не перезаписывается
+        std::pair<const_iterator, bool> insert(value_type entry);
+        std::pair<const_iterator, bool> emplace(Key key, Node value);
+
+        allocator_type get_allocator() const;
+        // Размер собственных буферов словаря: пар и хеш-индекса
+        size_t GetBufferBytes() const;
+
+        bool operator==(const Dict &rhs) const;
+        bool operator!=(const Dict &rhs) const;
+
+    private:
+        // Node забирает значения разрушаемого словаря, чтобы разрушить их без рекурсии
+        friend class Node;
+
+        // Позиция первого элемента с ключом не меньше key
+        size_t LowerBound(std::string_view key) const;
+        void RebuildIndex();
+        // Убирает из хеш-индекса элемент с номером pos, пока он ещё лежит в entries_
+        void EraseFromIndex(size_t pos);
+
+        Entries entries_;
+        // Номера элементов entries_, увеличенные на единицу; 0 - пустая ячейка
+        std::pmr::vector<uint32_t> index_;
+    };
+
+} // namespace json
@@ -1,4 +1,19 @@
 #include "json.h"
+#include "json_parser.h"
+#include "json_stats.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "structural_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <unordered_set>
 
 using namespace std;
 
@@ -6,527 +21,1401 @@ namespace json
 {
     namespace
     {
-        Node LoadNode(istream &input);
+        // Обработчик событий разбора, который собирает из них документ. Незавершённые массивы
+        // и словари лежат на явном стеке. Кадры стека переиспользуются следующими значениями
+        // той же глубины, а буфер элементов уходит в готовый узел, и следующий кадр копит свой заново
+        class DomBuilder
+        {
+        public:
+            // keys не нулевой, если ключи словарей хранятся в таблице документа
+            DomBuilder(std::string_view input, const LoadOptions &options, std::pmr::memory_resource *resource, KeyTable *keys)
+                : input_(input), options_(options), resource_(resource), keys_(keys) {}
 
-        using Number = std::variant<int, double>;
+            void OnNull()
+            {
+                Add(Node(nullptr));
+            }
 
-        Node LoadNull(std::istream &input)
-        {
-            if ('u' == input.get())
+            void OnBool(bool value)
             {
-                if ('l' == input.get())
-                {
-                    if ('l' == input.get())
-                    {
-                        char end = input.get();
-                        if ((end > 45 && end < 92) || (end > 93 && end < 125))
-                            throw ParsingError("Redundant symbols after null");
-                        input.putback(end);
-                        return Node(nullptr);
-                    }
-                }
+                Add(Node(value));
             }
-            throw ParsingError("Similiar to null value");
-        }
 
-        Node LoadBool(std::istream &input)
-        {
-            char c = input.get();
-            if ('t' == c)
+            void OnInt(int64_t value)
             {
-                if ('r' == input.get())
+                Add(Node(value));
+            }
+
+            void OnDouble(double value)
+            {
+                Add(Node(value));
+            }
+
+            void OnString(std::string_view value)
+            {
+                // Заимствовать можно только строку, которая лежит во входных данных, а не в буфере парсера
+                if (options_.borrow_strings && IsInput(value))
                 {
-                    if ('u' == input.get())
-                    {
-                        if ('e' == input.get())
-                        {
-                            char end = input.get();
-                            if ((end > 45 && end < 92) || (end > 93 && end < 125))
-                                throw ParsingError("Redundant symbols after true");
-                            input.putback(end);
-                            return Node(true);
-                        }
-                    }
+                    Add(Node::Borrow(value));
+                }
+                else
+                {
+                    Add(Node(std::string(value), resource_));
                 }
             }
-            else
+
+            void OnKey(std::string_view key)
+            {
+                frames_[depth_ - 1].key = keys_ != nullptr ? keys_->Intern(key) : Key(key);
+            }
+
+            void OnStartArray()
             {
-                if ('f' == c)
+                PushFrame().is_array = true;
+            }
+
+            void OnEndArray()
+            {
+                Frame &frame = frames_[--depth_];
+                Add(Node(move(frame.array)));
+                frame.array.clear();
+            }
+
+            void OnStartObject()
+            {
+                PushFrame().is_array = false;
+            }
+
+            void OnEndObject()
+            {
+                Frame &frame = frames_[--depth_];
+                // Пары собираются как есть, а сортируются один раз при создании словаря
+                Add(Node(Dict(move(frame.entries))));
+                frame.entries.clear();
+            }
+
+            Node TakeRoot()
+            {
+                return move(root_);
+            }
+
+            // Забирает элементы единственного незакрытого массива
+            Array TakeElements()
+            {
+                if (depth_ != 1 || !frames_[0].is_array)
                 {
-                    if ('a' == input.get())
-                    {
-                        if ('l' == input.get())
-                        {
-                            if ('s' == input.get())
-                            {
-                                if ('e' == input.get())
-                                {
-                                    char end = input.get();
-                                    if ((end > 45 && end < 92) || (end > 93 && end < 125))
-                                        throw ParsingError("Redundant symbols after false");
-                                    input.putback(end);
-                                    return Node(false);
-                                }
-                            }
-                        }
-                    }
+                    throw ParsingError("Expected ']'");
                 }
+                depth_ = 0;
+                return move(frames_[0].array);
             }
-            throw ParsingError("Similiar to boolean value");
-        }
 
-        Node LoadNumber(std::istream &input)
-        {
-            using namespace std::literals;
+        private:
+            struct Frame
+            {
+                explicit Frame(std::pmr::memory_resource *resource)
+                    : array(resource), entries(resource) {}
 
-            std::string parsed_num;
+                bool is_array = true;
+                Array array;
+                Dict::Entries entries;
+                Key key;
+            };
 
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input]
+            bool IsInput(std::string_view value) const
             {
-                parsed_num += static_cast<char>(input.get());
-                if (!input)
+                const std::less<const char *> less;
+                return !less(value.data(), input_.data()) && !less(input_.data() + input_.size(), value.data() + value.size());
+            }
+
+            Frame &PushFrame()
+            {
+                if (depth_ == frames_.size())
                 {
-                    throw ParsingError("Failed to read number from stream"s);
+                    frames_.emplace_back(resource_);
                 }
-            };
+                return frames_[depth_++];
+            }
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char]
+            void Add(Node node)
             {
-                if (!std::isdigit(input.peek()))
+                if (depth_ == 0)
                 {
-                    throw ParsingError("A digit is expected"s);
+                    root_ = move(node);
+                    return;
                 }
-                while (std::isdigit(input.peek()))
+                Frame &frame = frames_[depth_ - 1];
+                if (frame.is_array)
                 {
-                    read_char();
+                    frame.array.push_back(move(node));
                 }
-            };
+                else
+                {
+                    frame.entries.emplace_back(move(frame.key), move(node));
+                }
+            }
+
+            std::string_view input_;
+            const LoadOptions &options_;
+            std::pmr::memory_resource *resource_;
+            KeyTable *keys_;
+            std::vector<Frame> frames_;
+            size_t depth_ = 0;
+            Node root_;
+        };
+
+        // Обёртка обработчика, которая заполняет ParseStats. Парсер с ней - отдельный экземпляр
+        // шаблона, поэтому разбор без счётчиков не платит за них ничего. Промежуток от прошлого
+        // события до текущего - это время, ушедшее на токен, которым событие закончилось
+        template <typename Handler>
+        class StatsCollector
+        {
+        public:
+            StatsCollector(Handler &handler, ParseStats &stats)
+                : handler_(handler), stats_(stats), last_(Clock::now()) {}
 
-            if (input.peek() == '-')
+            void OnNull()
             {
-                read_char();
+                handler_.OnNull();
+                ++stats_.nodes;
+                Lap(nullptr);
             }
-            // Парсим целую часть числа
-            if (input.peek() == '0')
+
+            void OnBool(bool value)
             {
-                read_char();
-                // После 0 в JSON не могут идти другие цифры
+                handler_.OnBool(value);
+                ++stats_.nodes;
+                Lap(nullptr);
             }
-            else
+
+            void OnInt(int64_t value)
+            {
+                handler_.OnInt(value);
+                CountNumber();
+            }
+
+            void OnDouble(double value)
+            {
+                handler_.OnDouble(value);
+                CountNumber();
+            }
+
+            void OnString(std::string_view value)
+            {
+                handler_.OnString(value);
+                ++stats_.nodes;
+                ++stats_.strings;
+                stats_.string_bytes += value.size();
+                Lap(&stats_.string_time);
+            }
+
+            void OnKey(std::string_view key)
+            {
+                handler_.OnKey(key);
+                ++stats_.keys;
+                stats_.string_bytes += key.size();
+                Lap(&stats_.string_time);
+            }
+
+            void OnStartArray()
+            {
+                handler_.OnStartArray();
+                Open();
+            }
+
+            void OnEndArray()
+            {
+                handler_.OnEndArray();
+                --depth_;
+                Lap(nullptr);
+            }
+
+            void OnStartObject()
             {
-                read_digits();
+                handler_.OnStartObject();
+                Open();
             }
 
-            bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.')
+            void OnEndObject()
             {
-                read_char();
-                read_digits();
-                is_int = false;
+                handler_.OnEndObject();
+                --depth_;
+                Lap(nullptr);
             }
 
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E')
+            // Время с начала разбора ушло на структурный индекс
+            void OnIndexBuilt()
             {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-')
+                Lap(&stats_.index_time);
+            }
+
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            void CountNumber()
+            {
+                ++stats_.nodes;
+                ++stats_.numbers;
+                Lap(&stats_.number_time);
+            }
+
+            void Open()
+            {
+                ++stats_.nodes;
+                ++stats_.containers;
+                stats_.max_depth = std::max(stats_.max_depth, ++depth_);
+                Lap(nullptr);
+            }
+
+            // phase - куда отнести время токена; время скобок и литералов нигде не копится
+            void Lap(std::chrono::nanoseconds *phase)
+            {
+                const Clock::time_point now = Clock::now();
+                if (phase != nullptr)
                 {
-                    read_char();
+                    *phase += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_);
                 }
-                read_digits();
-                is_int = false;
+                last_ = now;
+            }
+
+            Handler &handler_;
+            ParseStats &stats_;
+            Clock::time_point last_;
+            size_t depth_ = 0;
+        };
+
+        // Та же память по умолчанию, но под другим адресом. Копия узла разделяет только значения
+        // из memory_resource по умолчанию, поэтому контейнеры с ключами из таблицы документа
+        // берут память отсюда: их копия, как и раньше, копирует ключи и не зависит от документа
+        class DocumentHeap : public std::pmr::memory_resource
+        {
+        private:
+            void *do_allocate(size_t bytes, size_t alignment) override
+            {
+                return upstream_->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void *ptr, size_t bytes, size_t alignment) override
+            {
+                upstream_->deallocate(ptr, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+            {
+                return this == &other;
+            }
+
+            std::pmr::memory_resource *upstream_ = std::pmr::get_default_resource();
+        };
+
+        // Память, которой владеет документ: входные данные заимствованных строк, арены узлов
+        // и таблицы ключей
+        struct DocumentStorage
+        {
+            explicit DocumentStorage(std::shared_ptr<const void> input, size_t initial_size)
+                : input(move(input)), arena(initial_size) {}
+
+            std::shared_ptr<const void> input;
+            std::pmr::monotonic_buffer_resource arena;
+            KeyTable keys;
+            DocumentHeap heap;
+            // Ни арена, ни таблица ключей не потокобезопасны, поэтому у каждого куска
+            // параллельного разбора они свои
+            std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> slice_arenas;
+            std::vector<std::unique_ptr<KeyTable>> slice_keys;
+        };
+
+        std::pmr::memory_resource *GetNodeResource(const LoadOptions &options, DocumentStorage *storage)
+        {
+            if (options.use_arena)
+            {
+                return &storage->arena;
             }
+            return options.intern_keys ? &storage->heap : std::pmr::get_default_resource();
+        }
 
+        // Меньшие куски не окупают запуск потока
+        constexpr size_t kMinSliceSize = 256 * 1024;
+        constexpr size_t kSlicesPerThread = 4;
+
+        // Режет корневой массив между элементами на куски примерно по slice_size байт.
+        // Кусок - это текст от начала первого элемента до конца последнего, без внешних запятых.
+        // Строки и вложенные скобки пропускаются через SkipValue, поэтому запятая внутри строки
+        // или вложенного значения не станет границей. На всём, что последовательный разбор
+        // мог бы понять иначе, возвращается пустой список, и разбор идёт в одном потоке
+        std::vector<std::string_view> SplitRootArray(std::string_view data, size_t slice_size)
+        {
+            const char *end = data.data() + data.size();
+            const char *pos = detail::SkipSpace(data.data(), end);
+            if (pos == end || *pos != '[')
+            {
+                return {};
+            }
+            ++pos;
+            std::vector<std::string_view> slices;
+            const char *slice_begin = nullptr;
+            const char *value_end = nullptr;
+            bool after_comma = false;
             try
             {
-                if (is_int)
+                while (true)
                 {
-                    // Сначала пробуем преобразовать строку в int
-                    try
+                    pos = detail::SkipSpace(pos, end);
+                    if (pos == end || (after_comma && (*pos == ',' || *pos == ']')))
+                    {
+                        return {};
+                    }
+                    if (*pos == ']')
+                    {
+                        break;
+                    }
+                    // Запятая стоит между элементами и только там
+                    if (value_end != nullptr && !after_comma)
+                    {
+                        if (*pos != ',')
+                        {
+                            return {};
+                        }
+                        ++pos;
+                        after_comma = true;
+                        continue;
+                    }
+                    const char c = *pos;
+                    if (c != '"' && c != '[' && c != '{' && c != 'n' && c != 't' && c != 'f' && !detail::IsNumberStart(c))
                     {
-                        return Node(std::stoi(parsed_num));
+                        return {};
                     }
-                    catch (...)
+                    if (slice_begin == nullptr)
                     {
-                        // В случае неудачи, например, при переполнении,
-                        // код ниже попробует преобразовать строку в double
+                        slice_begin = pos;
                     }
+                    value_end = detail::SkipValue(pos, end);
+                    if (static_cast<size_t>(value_end - slice_begin) >= slice_size)
+                    {
+                        slices.emplace_back(slice_begin, static_cast<size_t>(value_end - slice_begin));
+                        slice_begin = nullptr;
+                    }
+                    pos = value_end;
+                    after_comma = false;
                 }
-                return Node(std::stod(parsed_num));
             }
-            catch (...)
+            catch (const ParsingError &)
+            {
+                return {};
+            }
+            if (slice_begin != nullptr)
             {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+                slices.emplace_back(slice_begin, static_cast<size_t>(value_end - slice_begin));
             }
+            if (slices.size() < 2)
+            {
+                return {};
+            }
+            return slices;
+        }
+
+        template <typename Handler>
+        void FeedSlice(std::string_view slice, const LoadOptions &options, Handler &handler)
+        {
+            detail::EventParser<Handler> parser(handler, options.max_depth);
+            parser.Feed("["sv);
+            parser.Feed(slice);
+            // Запятая завершает число или литерал в конце куска, не открывая нового элемента
+            parser.Feed(","sv);
         }
 
-        Node LoadArray(istream &input)
+        // Разбирает кусок корневого массива так, будто он и есть массив
+        Array ParseSlice(std::string_view slice, std::string_view data, const LoadOptions &options, std::pmr::memory_resource *resource, KeyTable *keys, ParseStats *stats)
         {
-            Array result;
-            char c;
-            for (; input >> c && c != ']';)
+            DomBuilder builder(data, options, resource, keys);
+            if (stats == nullptr)
             {
-                if (c != ',')
-                {
-                    input.putback(c);
-                }
-                result.push_back(LoadNode(input));
+                FeedSlice(slice, options, builder);
             }
-            if (c != ']')
+            else
             {
-                throw ParsingError("Expected ']'");
+                StatsCollector<DomBuilder> collector(builder, *stats);
+                FeedSlice(slice, options, collector);
             }
-            return Node(move(result));
+            return builder.TakeElements();
         }
 
-        Node LoadString(istream &input)
+        // root_end - позиция сразу за корневым значением
+        void CheckDocumentEnd(const char *root_end, std::string_view data)
         {
-            using namespace std::literals;
+            const char *end = data.data() + data.size();
+            if (detail::SkipSpace(root_end, end) != end)
+            {
+                throw ParsingError("Redundant data after document");
+            }
+        }
 
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
-            while (true)
+        // whole_input - после корневого значения допускаются только пробелы
+        template <typename Handler>
+        void ParseWith(std::string_view data, const LoadOptions &options, bool whole_input, Handler &handler)
+        {
+            if (options.use_structural_index && data.size() <= std::numeric_limits<uint32_t>::max())
             {
-                if (it == end)
+                const std::vector<uint32_t> index = BuildStructuralIndex(data);
+                if constexpr (!std::is_same_v<Handler, DomBuilder>)
                 {
-                    // Поток закончился до того, как встретили закрывающую кавычку?
-                    throw ParsingError("String parsing error");
+                    handler.OnIndexBuilt();
                 }
-                const char ch = *it;
-                if (ch == '"')
+                detail::IndexedParser<Handler> parser(data, index, handler, options.max_depth);
+                parser.Parse();
+                if (whole_input)
                 {
-                    // Встретили закрывающую кавычку
-                    ++it;
-                    break;
+                    CheckDocumentEnd(parser.GetEnd(), data);
                 }
-                else if (ch == '\\')
+            }
+            else
+            {
+                detail::EventParser<Handler> parser(handler, options.max_depth);
+                const size_t consumed = parser.Feed(data);
+                parser.Finish();
+                if (whole_input)
                 {
-                    // Встретили начало escape-последовательности
-                    ++it;
-                    if (it == end)
-                    {
-                        // Поток завершился сразу после символа обратной косой черты
-                        throw ParsingError("String parsing error");
-                    }
-                    const char escaped_char = *(it);
-                    // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
-                    switch (escaped_char)
-                    {
-                    case 'n':
-                        s.push_back('\n');
-                        break;
-                    case 't':
-                        s.push_back('\t');
-                        break;
-                    case 'r':
-                        s.push_back('\r');
-                        break;
-                    case '"':
-                        s.push_back('"');
-                        break;
-                    case '\\':
-                        s.push_back('\\');
-                        break;
-                    default:
-                        // Встретили неизвестную escape-последовательность
-                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-                    }
+                    CheckDocumentEnd(data.data() + consumed, data);
                 }
-                else if (ch == '\n' || ch == '\r')
+            }
+        }
+
+        Node ParseSequential(std::string_view data, const LoadOptions &options, bool whole_input, std::pmr::memory_resource *resource, KeyTable *keys, ParseStats *stats)
+        {
+            DomBuilder builder(data, options, resource, keys);
+            if (stats == nullptr)
+            {
+                ParseWith(data, options, whole_input, builder);
+            }
+            else
+            {
+                *stats = {};
+                StatsCollector<DomBuilder> collector(builder, *stats);
+                ParseWith(data, options, whole_input, collector);
+            }
+            return builder.TakeRoot();
+        }
+
+        // Счётчики кусков складываются так, будто разбирался один массив
+        void MergeSliceStats(const std::vector<ParseStats> &slice_stats, ParseStats &stats)
+        {
+            stats = {};
+            for (const ParseStats &slice : slice_stats)
+            {
+                stats.nodes += slice.nodes;
+                stats.containers += slice.containers;
+                stats.strings += slice.strings;
+                stats.keys += slice.keys;
+                stats.numbers += slice.numbers;
+                stats.string_bytes += slice.string_bytes;
+                stats.max_depth = std::max(stats.max_depth, slice.max_depth);
+                stats.string_time += slice.string_time;
+                stats.number_time += slice.number_time;
+            }
+            // Каждый кусок открывал свой корневой массив
+            stats.nodes -= slice_stats.size() - 1;
+            stats.containers -= slice_stats.size() - 1;
+        }
+
+        // storage передаётся, когда документу нужна арена или таблица ключей.
+        // stats не нулевой, если нужны счётчики
+        Node ParseRoot(std::string_view data, const LoadOptions &options, bool whole_input, DocumentStorage *storage, ParseStats *stats)
+        {
+            std::pmr::memory_resource *resource = GetNodeResource(options, storage);
+            KeyTable *keys = options.intern_keys ? &storage->keys : nullptr;
+            const size_t threads = options.threads == 0 ? detail::GetDefaultThreadCount() : options.threads;
+            // Нарезка корневого массива не проверяет, что после него ничего нет
+            if (threads == 1 || whole_input || data.size() < 2 * kMinSliceSize)
+            {
+                return ParseSequential(data, options, whole_input, resource, keys, stats);
+            }
+            const std::vector<std::string_view> slices = SplitRootArray(data, std::max(kMinSliceSize, data.size() / (threads * kSlicesPerThread)));
+            if (slices.empty())
+            {
+                return ParseSequential(data, options, whole_input, resource, keys, stats);
+            }
+
+            std::vector<std::pmr::memory_resource *> resources(slices.size(), resource);
+            std::vector<KeyTable *> slice_keys(slices.size(), nullptr);
+            for (size_t i = 0; i < slices.size(); ++i)
+            {
+                if (options.use_arena)
                 {
-                    // Строковый литерал внутри- JSON не может прерываться символами \r или \n
-                    throw ParsingError("Unexpected end of line"s);
+                    storage->slice_arenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(slices[i].size()));
+                    resources[i] = storage->slice_arenas.back().get();
                 }
-                else
+                if (options.intern_keys)
                 {
-                    // Просто считываем очередной символ и помещаем его в результирующую строку
-                    s.push_back(ch);
+                    storage->slice_keys.push_back(std::make_unique<KeyTable>());
+                    slice_keys[i] = storage->slice_keys.back().get();
                 }
-                ++it;
+            }
+            std::vector<Array> parts;
+            parts.reserve(slices.size());
+            for (std::pmr::memory_resource *slice_resource : resources)
+            {
+                parts.emplace_back(slice_resource);
+            }
+            std::vector<ParseStats> slice_stats(stats != nullptr ? slices.size() : 0);
+            try
+            {
+                detail::ParallelFor(slices.size(), threads, [&](size_t i)
+                                    { parts[i] = ParseSlice(slices[i], data, options, resources[i], slice_keys[i], stats != nullptr ? &slice_stats[i] : nullptr); });
+            }
+            catch (const ParsingError &)
+            {
+                // Последовательный разбор бросит ровно ту ошибку, которую встретил бы первой
+                parts.clear();
+                return ParseSequential(data, options, whole_input, resource, keys, stats);
             }
 
-            return Node(std::move(s));
+            if (stats != nullptr)
+            {
+                MergeSliceStats(slice_stats, *stats);
+            }
+
+            // Узлы переносятся побайтно и продолжают ссылаться на память своего куска
+            size_t total = 0;
+            for (const Array &part : parts)
+            {
+                total += part.size();
+            }
+            // Корневой массив берёт память первого куска, чтобы не занимать основную арену
+            Array result(resources[0]);
+            result.reserve(total);
+            for (Array &part : parts)
+            {
+                std::move(part.begin(), part.end(), std::back_inserter(result));
+            }
+            return Node(move(result));
         }
 
-        Node LoadDict(istream &input)
+        Document ParseDocument(std::string_view data, const LoadOptions &options, bool whole_input, std::shared_ptr<const void> input_storage, ParseStats *stats)
         {
-            Dict result;
-            char c;
-            for (; input >> c && c != '}';)
+            if (!options.use_arena && !options.intern_keys)
             {
-                if (c == ',')
+                Node root = ParseRoot(data, options, whole_input, nullptr, stats);
+                if (!options.borrow_strings)
                 {
-                    input >> c;
+                    return Document{move(root)};
                 }
-
-                string key = LoadString(input).AsString();
-                input >> c;
-                result.insert({move(key), LoadNode(input)});
+                return Document{move(root), move(input_storage)};
             }
-            if (c != '}')
+            // Размер входа - разумная оценка объёма, который займут узлы
+            auto storage = std::make_shared<DocumentStorage>(input_storage, std::max<size_t>(data.size(), 1024));
+            Node root = ParseRoot(data, options, whole_input, storage.get(), stats);
+            if (!options.borrow_strings)
             {
-                throw ParsingError("Expected '}'");
+                storage->input.reset();
             }
-            return Node(move(result));
+            return Document{move(root), move(storage)};
+        }
+
+    } // namespace
+
+    namespace detail
+    {
+        Document LoadDocument(std::string_view data, const LoadOptions &options, std::shared_ptr<const void> input_storage, bool whole_input)
+        {
+            if (options.stats == nullptr && !HasParseStatsHook())
+            {
+                return ParseDocument(data, options, whole_input, move(input_storage), nullptr);
+            }
+            ParseStats local_stats;
+            ParseStats &stats = options.stats != nullptr ? *options.stats : local_stats;
+            const auto start = std::chrono::steady_clock::now();
+            Document doc = ParseDocument(data, options, whole_input, move(input_storage), &stats);
+            stats.total_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            stats.bytes = data.size();
+            stats.blocks = CountBlocks(doc.GetRoot());
+            ReportParseStats(stats);
+            return doc;
+        }
+
+    } // namespace detail
+
+    static_assert(sizeof(Node) == 16, "Node must stay compact");
+
+    template <typename Value>
+    Node::Box<Value> *Node::MakeBox(Value value, std::pmr::memory_resource *resource)
+    {
+        void *memory = resource->allocate(sizeof(Box<Value>), alignof(Box<Value>));
+        return new (memory) Box<Value>{resource, 1, std::move(value)};
+    }
+
+    template <typename Value>
+    void Node::FreeBox(Box<Value> *box)
+    {
+        std::pmr::memory_resource *resource = box->resource;
+        box->~Box<Value>();
+        resource->deallocate(box, sizeof(Box<Value>), alignof(Box<Value>));
+    }
+
+    template <typename Value>
+    void Node::AddRef(Box<Value> *box) noexcept
+    {
+        box->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename Value>
+    bool Node::DropRef(Box<Value> *box) noexcept
+    {
+        // Единственному владельцу не с кем гоняться, и атомарная запись не нужна
+        if (box->refs.load(std::memory_order_acquire) == 1)
+        {
+            return true;
+        }
+        return box->refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    Node Node::Share(const Node &other) noexcept
+    {
+        Node node;
+        node.ShareFrom(other);
+        return node;
+    }
+
+    std::pmr::memory_resource *Node::GetBoxResource() const noexcept
+    {
+        switch (type_)
+        {
+        case Type::String:
+            return string_->resource;
+        case Type::Array:
+            return array_->resource;
+        case Type::Dict:
+            return dict_->resource;
+        default:
+            return nullptr;
+        }
+    }
+
+    bool Node::IsUnique() const noexcept
+    {
+        switch (type_)
+        {
+        case Type::Array:
+            return array_->refs.load(std::memory_order_acquire) == 1;
+        case Type::Dict:
+            return dict_->refs.load(std::memory_order_acquire) == 1;
+        default:
+            return true;
+        }
+    }
+
+    Node::Node() noexcept
+        : chars_(nullptr) {}
+
+    Node::Node(std::nullptr_t) noexcept
+        : Node() {}
+
+    Node::Node(int value) noexcept
+        : int_(value), type_(Type::Int) {}
+
+    // Значения, которые помещаются в int, хранятся как int, чтобы IsInt работал как раньше
+    Node::Node(int64_t value) noexcept
+    {
+        if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max())
+        {
+            int_ = static_cast<int>(value);
+            type_ = Type::Int;
         }
+        else
+        {
+            int64_ = value;
+            type_ = Type::Int64;
+        }
+    }
+
+    Node::Node(double value) noexcept
+        : double_(value), type_(Type::Double) {}
+
+    Node::Node(bool value) noexcept
+        : bool_(value), type_(Type::Bool) {}
+
+    Node::Node(const char *value)
+        : Node(std::string(value)) {}
+
+    Node::Node(std::string value, std::pmr::memory_resource *resource)
+        : string_(MakeBox(move(value), resource)), type_(Type::String) {}
+
+    Node::Node(std::string_view value)
+        : Node(std::string(value)) {}
+
+    Node Node::Borrow(std::string_view value)
+    {
+        if (value.size() > std::numeric_limits<uint32_t>::max())
+        {
+            return Node(value);
+        }
+        Node node;
+        node.chars_ = value.data();
+        node.size_ = static_cast<uint32_t>(value.size());
+        node.type_ = Type::BorrowedString;
+        return node;
+    }
 
-        Node LoadNode(istream &input)
+    // Блок контейнера берётся из той же памяти, что и его элементы
+    Node::Node(Array value)
+        : array_(MakeBox(move(value), value.get_allocator().resource())), type_(Type::Array) {}
+
+    Node::Node(Dict value)
+        : dict_(MakeBox(move(value), value.get_allocator().resource())), type_(Type::Dict) {}
+
+    Node::Node(const Node &other)
+    {
+        CopyFrom(other);
+    }
+
+    Node::Node(Node &&other) noexcept
+    {
+        // Все альтернативы тривиально копируются, поэтому достаточно скопировать представление
+        std::memcpy(static_cast<void *>(this), &other, sizeof(Node));
+        other.type_ = Type::Null;
+        other.size_ = 0;
+    }
+
+    Node &Node::operator=(const Node &rhs)
+    {
+        if (this != &rhs)
+        {
+            Node copy(rhs);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    Node &Node::operator=(Node &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            Release();
+            std::memcpy(static_cast<void *>(this), &rhs, sizeof(Node));
+            rhs.type_ = Type::Null;
+            rhs.size_ = 0;
+        }
+        return *this;
+    }
+
+    Node::~Node()
+    {
+        Release();
+    }
+
+    // Узел должен быть пустым: прежнее значение не освобождается
+    void Node::ShareFrom(const Node &other) noexcept
+    {
+        std::memcpy(static_cast<void *>(this), &other, sizeof(Node));
+        switch (type_)
+        {
+        case Type::String:
+            AddRef(string_);
+            break;
+        case Type::Array:
+            AddRef(array_);
+            break;
+        case Type::Dict:
+            AddRef(dict_);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Копия всегда размещается в обычной куче и не зависит от памяти документа: значение
+    // из кучи разделяется, а из арены или другого memory_resource копируется целиком
+    void Node::CopyFrom(const Node &other)
+    {
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+        if (other.GetBoxResource() == resource)
+        {
+            ShareFrom(other);
+            return;
+        }
+        switch (other.type_)
         {
-            char c;
-            input >> c;
+        case Type::String:
+            string_ = MakeBox(other.string_->value, resource);
+            break;
+        case Type::Array:
+            array_ = MakeBox(Array(other.array_->value, resource), resource);
+            break;
+        case Type::Dict:
+            dict_ = MakeBox(Dict(other.dict_->value), resource);
+            break;
+        default:
+            std::memcpy(static_cast<void *>(this), &other, sizeof(Node));
+            return;
+        }
+        size_ = 0;
+        type_ = other.type_;
+    }
 
-            if (c == '[')
+    // Глубокое дерево разрушается по явному стеку: непустые дочерние контейнеры сначала
+    // переносятся в pending, поэтому деструкторы элементов не уходят вглубь
+    void Node::Release() noexcept
+    {
+        switch (type_)
+        {
+        case Type::String:
+            if (DropRef(string_))
             {
-                return LoadArray(input);
+                FreeBox(string_);
             }
-            else if (c == '{')
+            break;
+        case Type::Array:
+        case Type::Dict:
+        {
+            // Общий контейнер остаётся другим владельцам вместе с элементами
+            if (type_ == Type::Array ? !DropRef(array_) : !DropRef(dict_))
             {
-                return LoadDict(input);
+                break;
             }
-            else if (c == '"')
+            std::vector<Node> pending;
+            DetachChildren(pending);
+            if (type_ == Type::Array)
             {
-                return LoadString(input);
+                FreeBox(array_);
             }
-            else if (c == 'n')
+            else
             {
-                return LoadNull(input);
+                FreeBox(dict_);
             }
-            else if (c == 't' || c == 'f')
+            while (!pending.empty())
             {
-                input.putback(c);
-                return LoadBool(input);
+                Node node = std::move(pending.back());
+                pending.pop_back();
+                node.DetachChildren(pending);
             }
-            else if ((c > 47 && c < 58) || c == '.' || c == '+' || c == '-')
+            break;
+        }
+        default:
+            break;
+        }
+        type_ = Type::Null;
+        size_ = 0;
+    }
+
+    void Node::DetachChildren(std::vector<Node> &pending) noexcept
+    {
+        const auto detach = [&pending](Node &child) noexcept
+        {
+            // Элементы общего контейнера не трогаются: узел просто отпустит свою ссылку
+            const bool has_children = ((child.type_ == Type::Array && !child.array_->value.empty()) ||
+                                       (child.type_ == Type::Dict && !child.dict_->value.empty())) &&
+                                      child.IsUnique();
+            if (!has_children)
             {
-                input.putback(c);
-                return LoadNumber(input);
+                return;
             }
-            else
+            try
+            {
+                pending.push_back(std::move(child));
+            }
+            catch (const std::bad_alloc &)
             {
-                throw ParsingError("Unexpected symbol");
+                // Памяти под стек нет: это поддерево разрушится рекурсивно
+            }
+        };
+        if (type_ == Type::Array)
+        {
+            for (Node &item : array_->value)
+            {
+                detach(item);
             }
         }
+        else if (type_ == Type::Dict)
+        {
+            for (auto &entry : dict_->value.entries_)
+            {
+                detach(entry.second);
+            }
+        }
+    }
 
-    } // namespace
-
-    const Node::Value &Node::GetValue() const { return data_; }
+    Node::Type Node::GetType() const
+    {
+        return type_;
+    }
 
     const Array &Node::AsArray() const
     {
         if (IsArray())
-            return std::get<Array>(data_);
+            return array_->value;
         throw std::logic_error("Logic error");
     }
     const Dict &Node::AsMap() const
     {
         if (IsMap())
-            return std::get<Dict>(data_);
+            return dict_->value;
         throw std::logic_error("Logic error");
     }
+
+    // Копия верхнего уровня копирует элементы конструктором копирования Node, то есть
+    // разделяет их вынесенные значения
+    Array &Node::AsMutableArray()
+    {
+        if (!IsArray())
+            throw std::logic_error("Logic error");
+        if (!IsUnique())
+        {
+            *this = Node(Array(array_->value, std::pmr::get_default_resource()));
+        }
+        return array_->value;
+    }
+
+    Dict &Node::AsMutableMap()
+    {
+        if (!IsMap())
+            throw std::logic_error("Logic error");
+        if (!IsUnique())
+        {
+            *this = Node(Dict(dict_->value));
+        }
+        return dict_->value;
+    }
     int Node::AsInt() const
     {
         if (IsInt())
-            return std::get<int>(data_);
+            return int_;
+        throw std::logic_error("Logic error");
+    }
+    int64_t Node::AsInt64() const
+    {
+        if (type_ == Type::Int64)
+            return int64_;
+        if (IsInt())
+            return int_;
         throw std::logic_error("Logic error");
     }
     const string &Node::AsString() const
     {
-        if (IsString())
-            return std::get<std::string>(data_);
+        if (type_ == Type::String)
+            return string_->value;
+        if (type_ == Type::BorrowedString)
+            throw std::logic_error("String is borrowed, use AsStringView");
+        throw std::logic_error("Logic error");
+    }
+    std::string_view Node::AsStringView() const
+    {
+        if (type_ == Type::String)
+            return string_->value;
+        if (type_ == Type::BorrowedString)
+            return {chars_, size_};
         throw std::logic_error("Logic error");
     }
     double Node::AsDouble() const
     {
         if (IsPureDouble())
-            return std::get<double>(data_);
-        if (IsInt())
-            return static_cast<double>(AsInt());
+            return double_;
+        if (IsInt64())
+            return static_cast<double>(AsInt64());
         throw std::logic_error("Logic error");
     }
     bool Node::AsBool() const
     {
         if (IsBool())
-            return std::get<bool>(data_);
+            return bool_;
         throw std::logic_error("Logic error");
     }
 
     bool Node::IsArray() const
     {
-        return std::holds_alternative<Array>(data_);
+        return type_ == Type::Array;
     }
     bool Node::IsMap() const
     {
-        return std::holds_alternative<Dict>(data_);
+        return type_ == Type::Dict;
     }
     bool Node::IsInt() const
     {
-        return std::holds_alternative<int>(data_);
+        return type_ == Type::Int;
+    }
+    bool Node::IsInt64() const
+    {
+        return type_ == Type::Int || type_ == Type::Int64;
     }
     bool Node::IsPureDouble() const
     {
-        return std::holds_alternative<double>(data_);
+        return type_ == Type::Double;
     }
     bool Node::IsDouble() const
     {
-        return IsPureDouble() || IsInt();
+        return IsPureDouble() || IsInt64();
     }
     bool Node::IsNull() const
     {
-        return std::holds_alternative<std::nullptr_t>(data_);
+        return type_ == Type::Null;
     }
     bool Node::IsBool() const
     {
-        return std::holds_alternative<bool>(data_);
+        return type_ == Type::Bool;
     }
     bool Node::IsString() const
     {
-        return std::holds_alternative<std::string>(data_);
+        return type_ == Type::String || type_ == Type::BorrowedString;
     }
 
     bool Node::operator==(const Node &rhs) const
     {
-        if (std::holds_alternative<double>(this->data_) && std::holds_alternative<double>(rhs.data_))
+        // Собственная и заимствованная строки равны, если совпадает содержимое
+        if (IsString() && rhs.IsString())
         {
-            return std::abs(std::get<double>(this->data_) - std::get<double>(rhs.data_)) < 0.00001;
+            return AsStringView() == rhs.AsStringView();
+        }
+        if (type_ != rhs.type_)
+        {
+            return false;
+        }
+        switch (type_)
+        {
+        case Type::Int:
+            return int_ == rhs.int_;
+        case Type::Int64:
+            return int64_ == rhs.int64_;
+        case Type::Double:
+            return std::abs(double_ - rhs.double_) < 0.00001;
+        case Type::Bool:
+            return bool_ == rhs.bool_;
+        // Общий контейнер равен сам себе без обхода
+        case Type::Array:
+            return array_ == rhs.array_ || array_->value == rhs.array_->value;
+        case Type::Dict:
+            return dict_ == rhs.dict_ || dict_->value == rhs.dict_->value;
+        default:
+            return true;
         }
-        return this->data_ == rhs.data_;
     }
     bool Node::operator!=(const Node &rhs) const
     {
         return !(*this == rhs);
     }
 
+    size_t MemoryUsage::GetTotalBytes() const
+    {
+        return node_bytes + container_bytes + string_bytes;
+    }
+
+    namespace
+    {
+        // Перед вынесенным значением лежат его memory_resource и счётчик ссылок
+        constexpr size_t kBoxHeaderBytes = sizeof(std::pmr::memory_resource *) + sizeof(std::atomic<size_t>);
+
+        // Память под символы строки, если они не поместились во внутренний буфер
+        size_t StringHeapBytes(const std::string &str)
+        {
+            static const size_t sso_capacity = std::string().capacity();
+            return str.capacity() > sso_capacity ? str.capacity() + 1 : 0;
+        }
+
+        // Строки таблицы ключей, уже учтённые в string_bytes
+        using SeenKeys = std::unordered_set<const char *>;
+
+        void AccumulateKeyUsage(const Key &key, MemoryUsage &usage, SeenKeys &seen_keys)
+        {
+            if (!key.IsInterned())
+            {
+                usage.string_bytes += key.GetHeapBytes();
+                return;
+            }
+            ++usage.interned_keys;
+            if (seen_keys.insert(key.data()).second)
+            {
+                usage.string_bytes += key.size();
+            }
+            else if (key.size() > Key::kInlineCapacity)
+            {
+                // Без таблицы повтор длинного ключа занял бы свой блок в куче
+                usage.interned_bytes_saved += key.size();
+            }
+        }
+
+        void AccumulateMemoryUsage(const Node &node, MemoryUsage &usage, SeenKeys &seen_keys)
+        {
+            ++usage.nodes;
+            node.Visit([&usage, &seen_keys](const auto &value)
+                       {
+                using Value = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<Value, std::string>)
+                {
+                    usage.string_bytes += kBoxHeaderBytes + sizeof(std::string) + StringHeapBytes(value);
+                }
+                else if constexpr (std::is_same_v<Value, Array>)
+                {
+                    usage.container_bytes += kBoxHeaderBytes + sizeof(Array);
+                    usage.node_bytes += (value.capacity() - value.size()) * sizeof(Node);
+                    for (const Node &item : value)
+                    {
+                        AccumulateMemoryUsage(item, usage, seen_keys);
+                    }
+                }
+                else if constexpr (std::is_same_v<Value, Dict>)
+                {
+                    // Узлы внутри пар учитываются в node_bytes
+                    usage.container_bytes += kBoxHeaderBytes + sizeof(Dict) + value.GetBufferBytes() - value.size() * sizeof(Node);
+                    for (const auto &[key, item] : value)
+                    {
+                        AccumulateKeyUsage(key, usage, seen_keys);
+                        AccumulateMemoryUsage(item, usage, seen_keys);
+                    }
+                } });
+        }
+
+    } // namespace
+
+    MemoryUsage ComputeMemoryUsage(const Node &node)
+    {
+        MemoryUsage usage;
+        SeenKeys seen_keys;
+        AccumulateMemoryUsage(node, usage, seen_keys);
+        usage.node_bytes += usage.nodes * sizeof(Node);
+        return usage;
+    }
+
     Document::Document(Node root)
         : root_(move(root)) {}
 
+    Document::Document(Node root, std::shared_ptr<const void> storage)
+        : storage_(move(storage)), root_(move(root)) {}
+
+    // Копия держит storage, поэтому корень разделяется, даже если лежит в арене
+    Document::Document(const Document &other)
+        : storage_(other.storage_), root_(Node::Share(other.root_)) {}
+
+    Document &Document::operator=(const Document &rhs)
+    {
+        return *this = Document(rhs);
+    }
+
+    Document &Document::operator=(Document &&rhs)
+    {
+        if (this != &rhs)
+        {
+            root_ = Node{};
+            storage_ = move(rhs.storage_);
+            root_ = move(rhs.root_);
+        }
+        return *this;
+    }
+
     const Node &Document::GetRoot() const
     {
         return root_;
     }
 
-    bool Document::operator==(const Document &rhs) const
+    // Узел, полученный по ссылке, можно переместить из документа, поэтому дерево из арены
+    // или с ключами из таблицы документа один раз копируется в кучу целиком
+    Node &Document::GetMutableRoot()
     {
-        return root_ == rhs.root_;
+        std::pmr::memory_resource *resource = root_.GetBoxResource();
+        if (resource != nullptr && resource != std::pmr::get_default_resource())
+        {
+            root_ = Node(root_);
+        }
+        return root_;
     }
 
-    bool Document::operator!=(const Document &rhs) const
+    MemoryUsage Document::GetMemoryUsage() const
     {
-        return !(*this == rhs);
+        return ComputeMemoryUsage(root_);
     }
 
-    Document Load(istream &input)
+    bool Document::operator==(const Document &rhs) const
     {
-        return Document{LoadNode(input)};
+        return root_ == rhs.root_;
     }
 
-    void PrintNode(const Node &node, std::ostream &out);
+    bool Document::operator!=(const Document &rhs) const
+    {
+        return !(*this == rhs);
+    }
 
-    template <typename Type>
-    void PrintValue(const Type &value, std::ostream &out)
+    Document Load(std::string_view input, const LoadOptions &options)
     {
-        out << value;
+        return Load(input.data(), input.size(), options);
     }
 
-    void PrintValue(std::nullptr_t, std::ostream &out)
+    Document Load(const char *data, size_t size, const LoadOptions &options)
     {
-        out << "null"sv;
+        return detail::LoadDocument({data, size}, options, nullptr);
     }
 
-    void PrintValue(const json::Dict &dict, std::ostream &out)
+    Document Load(istream &input)
     {
-        out << "{ "sv;
-        bool isSinglePair = true;
-        for (const auto &[key, value] : dict)
+        // Поток разбирается кусками по мере чтения, без копии всего текста в памяти. Кусок - это
+        // то, что уже лежит в буфере потока, поэтому байты после корневого значения, прочитанные
+        // вместе с ним, можно вернуть в поток через sungetc
+        static constexpr size_t kChunkSize = 64 * 1024;
+        IncrementalParser parser;
+        const istream::sentry sentry(input, true);
+        std::streambuf *buffer = sentry ? input.rdbuf() : nullptr;
+        std::string chunk(kChunkSize, '\0');
+        while (buffer != nullptr && parser.GetStatus() == ParseStatus::NeedMore)
         {
-            if (!isSinglePair)
+            if (buffer->in_avail() <= 0 && std::char_traits<char>::eq_int_type(buffer->sgetc(), std::char_traits<char>::eof()))
             {
-                out << " , "sv;
+                input.setstate(ios::eofbit);
+                break;
             }
-            PrintNode(key, out);
-            out << " : "sv;
-            PrintNode(value, out);
-            isSinglePair = false;
+            const auto available = static_cast<size_t>(std::max<std::streamsize>(buffer->in_avail(), 1));
+            const auto count = static_cast<size_t>(buffer->sgetn(chunk.data(), static_cast<std::streamsize>(std::min(available, chunk.size()))));
+            if (parser.Feed({chunk.data(), count}) == ParseStatus::Done)
+            {
+                for (size_t tail = count - parser.GetConsumed(); tail != 0; --tail)
+                {
+                    if (std::char_traits<char>::eq_int_type(buffer->sungetc(), std::char_traits<char>::eof()))
+                    {
+                        // Буфер не сохранил прочитанное: остаток потерян
+                        input.setstate(ios::badbit);
+                        break;
+                    }
+                }
+            }
+        }
+        if (parser.Finish() == ParseStatus::Error)
+        {
+            throw ParsingError(parser.GetError());
         }
-        out << " }"sv;
+        return parser.TakeDocument();
     }
 
-    void PrintValue(const std::string &str, std::ostream &out)
+    struct IncrementalParser::Impl
     {
-        out << "\""sv;
-        PrintEscape(str, out);
-        out << "\""sv;
-    }
+        // Размер первого блока арены: размер документа заранее неизвестен
+        static constexpr size_t kInitialArenaSize = 64 * 1024;
+
+        explicit Impl(const LoadOptions &load_options)
+            : options(load_options),
+              storage(options.use_arena || options.intern_keys ? std::make_shared<DocumentStorage>(nullptr, kInitialArenaSize) : nullptr),
+              builder({}, options, GetNodeResource(options, storage.get()), options.intern_keys ? &storage->keys : nullptr),
+              parser(builder, options.max_depth) {}
+
+        LoadOptions options;
+        std::shared_ptr<DocumentStorage> storage;
+        DomBuilder builder;
+        detail::EventParser<DomBuilder> parser;
+        ParseStatus status = ParseStatus::NeedMore;
+        size_t consumed = 0;
+        std::string error;
+    };
+
+    IncrementalParser::IncrementalParser(const LoadOptions &options)
+        : impl_(std::make_unique<Impl>(options)) {}
 
-    void PrintValue(const json::Array &array, std::ostream &out)
+    IncrementalParser::~IncrementalParser() = default;
+    IncrementalParser::IncrementalParser(IncrementalParser &&) noexcept = default;
+    IncrementalParser &IncrementalParser::operator=(IncrementalParser &&) noexcept = default;
+
+    ParseStatus IncrementalParser::Feed(std::string_view chunk)
     {
-        out << "["sv;
-        bool is_first = true;
-        for (const auto &value : array)
+        impl_->consumed = 0;
+        if (impl_->status != ParseStatus::NeedMore)
         {
-            if (is_first)
-            {
-                is_first = false;
-            }
-            else
+            return impl_->status;
+        }
+        try
+        {
+            impl_->consumed = impl_->parser.Feed(chunk);
+            if (impl_->parser.IsDone())
             {
-                out << ","sv;
+                impl_->status = ParseStatus::Done;
             }
-            PrintNode(value, out);
         }
-        out << "]"sv;
+        catch (const ParsingError &e)
+        {
+            impl_->status = ParseStatus::Error;
+            impl_->error = e.what();
+        }
+        return impl_->status;
     }
 
-    void PrintValue(const bool value, std::ostream &out)
+    ParseStatus IncrementalParser::Finish()
     {
-        if (value)
-            out << "true";
-        else
-            out << "false";
+        if (impl_->status != ParseStatus::NeedMore)
+        {
+            return impl_->status;
+        }
+        try
+        {
+            impl_->parser.Finish();
+            impl_->status = ParseStatus::Done;
+        }
+        catch (const ParsingError &e)
+        {
+            impl_->status = ParseStatus::Error;
+            impl_->error = e.what();
+        }
+        return impl_->status;
+    }
+
+    ParseStatus IncrementalParser::GetStatus() const
+    {
+        return impl_->status;
     }
 
-    void PrintNode(const Node &node, std::ostream &out)
+    size_t IncrementalParser::GetConsumed() const
     {
-        std::visit(
-            [&out](const auto &value)
-            { PrintValue(value, out); },
-            node.GetValue());
+        return impl_->consumed;
     }
 
-    void Print(const Document &doc, std::ostream &out)
+    const std::string &IncrementalParser::GetError() const
     {
-        auto &root = doc.GetRoot();
-        PrintNode(root, out);
+        return impl_->error;
     }
 
-    void PrintEscape(const std::string &str, std::ostream &out)
+    Document IncrementalParser::TakeDocument()
     {
-        for (char c : str)
+        if (impl_->status != ParseStatus::Done)
         {
-            switch (c)
-            {
-            case '\"':
-                out << "\\\"";
-                break;
-            case '\\':
-                out << "\\\\";
-                break;
-            case '\n':
-                out << "\\n";
-                break;
-            case '\r':
-                out << "\\r";
-                break;
-            case '\t':
-                out << "\\t";
-                break;
-            default:
-                out << c;
-                break;
-            }
+            throw std::logic_error("Document is not parsed yet");
+        }
+        Node root = impl_->builder.TakeRoot();
+        if (impl_->storage == nullptr)
+        {
+            return Document{move(root)};
         }
+        return Document{move(root), move(impl_->storage)};
+    }
+
+    Document LoadFile(const std::string &path, const LoadOptions &options)
+    {
+        // Если строки не заимствуются, отображение освобождается сразу после разбора
+        auto file = std::make_shared<MappedFile>(path);
+        const std::string_view data = file->GetData();
+        return detail::LoadDocument(data, options, move(file));
+    }
+
+    std::string ToString(const Document &doc, const PrintOptions &options)
+    {
+        Writer writer;
+        if (options.stats == nullptr && !detail::HasPrintStatsHook())
+        {
+            writer.WriteNode(doc.GetRoot(), options.threads);
+            return writer.TakeData();
+        }
+        PrintStats local_stats;
+        PrintStats &stats = options.stats != nullptr ? *options.stats : local_stats;
+        const auto start = std::chrono::steady_clock::now();
+        writer.WriteNode(doc.GetRoot(), options.threads);
+        stats.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        stats.bytes = writer.GetData().size();
+        // Узлы считаются отдельным обходом после замера, чтобы не замедлять вывод
+        detail::CountNodes(doc.GetRoot(), stats.nodes, stats.max_depth);
+        detail::ReportPrintStats(stats);
+        return writer.TakeData();
+    }
+
+    void Print(const Document &doc, std::ostream &out, const PrintOptions &options)
+    {
+        const std::string text = ToString(doc, options);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    void PrintEscape(std::string_view str, std::ostream &out)
+    {
+        Writer writer;
+        writer.WriteEscaped(str);
+        const std::string_view text = writer.GetData();
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
     }
 } // namespace json
\ No newline at end of file
@@ -1,18 +1,27 @@
 #pragma once
 
+#include "dict.h"
+
+#include <atomic>
+#include <cstdint>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <variant>
 #include <sstream>
 
 namespace json
 {
     class Node;
-    // Сохраните объявления Dict и Array без изменения
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    // Объявлены в json_stats.h
+    struct ParseStats;
+    struct PrintStats;
+    // Контейнеры берут память из std::pmr::memory_resource: по умолчанию из кучи,
+    // а в документе, загруженном с LoadOptions::use_arena, - из арены документа.
+    // Dict объявлен в dict.h
+    using Array = std::pmr::vector<Node>;
 
     // Эта ошибка должна выбрасываться при ошибках парсинга JSON
     class ParsingError : public std::runtime_error
@@ -21,24 +30,81 @@ namespace json
         using runtime_error::runtime_error;
     };
 
+    // Узел занимает 16 байт: значение или указатель на вынесенный в память контейнер,
+    // длина заимствованной строки и тег типа. Строки, массивы и словари лежат в отдельных
+    // блоках, выделенных из того же memory_resource, что и сами контейнеры.
+    // Вынесенное значение из обычной кучи не копируется вместе с узлом, а разделяется
+    // со счётчиком ссылок, поэтому копия узла стоит O(1). Общее значение не меняется:
+    // AsMutableArray и AsMutableMap сначала забирают себе копию его верхнего уровня.
+    // Копировать и читать узлы с общими значениями можно из разных потоков, менять
+    // один узел одновременно из нескольких потоков по-прежнему нельзя
     class Node
     {
     public:
-        using Value = std::variant<std::nullptr_t, int, double, std::string, bool, Array, Dict>;
-        Node() = default;
-        template <typename Type>
-        Node(Type value) : data_(std::move(value)) {}
+        enum class Type : uint8_t
+        {
+            Null,
+            Int,
+            Double,
+            String,
+            Bool,
+            Array,
+            Dict,
+            // Строка, заимствованная из входного буфера (см. LoadOptions::borrow_strings)
+            BorrowedString,
+            // Целое, которое не помещается в int
+            Int64,
+        };
+
+        Node() noexcept;
+        Node(std::nullptr_t) noexcept;
+        Node(int value) noexcept;
+        Node(int64_t value) noexcept;
+        Node(double value) noexcept;
+        Node(bool value) noexcept;
+        Node(const char *value);
+        Node(std::string value, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+        // Строка копируется, как и из std::string
+        explicit Node(std::string_view value);
+        Node(Array value);
+        Node(Dict value);
+
+        // Заимствованная строка: узел ссылается на value, и данные должны пережить узел.
+        // Строки длиннее 4 ГБ не помещаются в узел и копируются
+        static Node Borrow(std::string_view value);
+
+        Node(const Node &other);
+        Node(Node &&other) noexcept;
+        Node &operator=(const Node &rhs);
+        Node &operator=(Node &&rhs) noexcept;
+        ~Node();
+
+        Type GetType() const;
 
-        const Value &GetValue() const;
+        // Вызывает visitor со значением узла: nullptr, int, double, const std::string &,
+        // bool, const Array &, const Dict &, std::string_view для заимствованной строки
+        // или int64_t для целого вне диапазона int
+        template <typename Visitor>
+        decltype(auto) Visit(Visitor &&visitor) const;
 
         const Array &AsArray() const;
         const Dict &AsMap() const;
+        // Доступ на запись. Контейнер, разделённый с копиями узла, сначала копируется в кучу:
+        // копируется только сам контейнер, элементы остаются общими до их собственного изменения.
+        // Поэтому правка листа копирует лишь контейнеры на пути к нему от корня
+        Array &AsMutableArray();
+        Dict &AsMutableMap();
         int AsInt() const;
+        // Любое целое: и int, и не поместившееся в int
+        int64_t AsInt64() const;
+        // Для заимствованной строки бросает std::logic_error, её читают через AsStringView
         const std::string &AsString() const;
+        std::string_view AsStringView() const;
         double AsDouble() const;
         bool AsBool() const;
 
         bool IsInt() const;
+        bool IsInt64() const;
         bool IsDouble() const;
         bool IsPureDouble() const;
         bool IsBool() const;
@@ -51,23 +117,233 @@ namespace json
         bool operator!=(const Node &rhs) const;
 
     private:
-        Value data_;
+        // Вынесенное значение помнит, из какого memory_resource его выделили
+        template <typename Value>
+        struct Box
+        {
+            std::pmr::memory_resource *resource;
+            // Сколько узлов ссылаются на значение
+            std::atomic<size_t> refs;
+            Value value;
+        };
+
+        template <typename Value>
+        static Box<Value> *MakeBox(Value value, std::pmr::memory_resource *resource);
+        template <typename Value>
+        static void FreeBox(Box<Value> *box);
+        template <typename Value>
+        static void AddRef(Box<Value> *box) noexcept;
+        // true, если ссылка была последней и значение пора освободить
+        template <typename Value>
+        static bool DropRef(Box<Value> *box) noexcept;
+
+        // Копия, разделяющая значение независимо от того, где оно лежит. Годится, только
+        // если память значения переживёт копию, как у копии документа вместе с его storage
+        static Node Share(const Node &other) noexcept;
+        // Память вынесенного значения или nullptr для значений, хранящихся в самом узле
+        std::pmr::memory_resource *GetBoxResource() const noexcept;
+        // Контейнер не разделён с другими узлами
+        bool IsUnique() const noexcept;
+
+        void ShareFrom(const Node &other) noexcept;
+        void CopyFrom(const Node &other);
+        void Release() noexcept;
+        // Переносит в pending непустые дочерние контейнеры
+        void DetachChildren(std::vector<Node> &pending) noexcept;
+
+        friend class Document;
+
+        union
+        {
+            int int_;
+            int64_t int64_;
+            double double_;
+            bool bool_;
+            Box<std::string> *string_;
+            const char *chars_;
+            Box<Array> *array_;
+            Box<Dict> *dict_;
+        };
+        // Длина заимствованной строки
+        uint32_t size_ = 0;
+        Type type_ = Type::Null;
     };
 
+    // Сколько памяти занимает дерево узлов
+    struct MemoryUsage
+    {
+        size_t nodes = 0;
+        // Сами узлы, включая свободные места в буферах массивов
+        size_t node_bytes = 0;
+        // Блоки контейнеров, пары и индексы словарей. Значения, общие для нескольких копий,
+        // учитываются в каждом узле, который на них ссылается
+        size_t container_bytes = 0;
+        // Собственные строки, не поместившиеся в SSO, длинные ключи и строки таблицы ключей
+        size_t string_bytes = 0;
+        // Ключи, взятые из таблицы ключей документа (см. LoadOptions::intern_keys)
+        size_t interned_keys = 0;
+        // Сколько заняли бы в куче повторы длинных ключей, если бы каждый хранил свою копию
+        size_t interned_bytes_saved = 0;
+
+        size_t GetTotalBytes() const;
+    };
+
+    MemoryUsage ComputeMemoryUsage(const Node &node);
+
     class Document
     {
     public:
         explicit Document(Node root);
+        // storage продлевает жизнь памяти, на которую ссылаются заимствованные строки
+        Document(Node root, std::shared_ptr<const void> storage);
+
+        // Копия разделяет корень и storage, поэтому стоит O(1) при любом размере документа
+        Document(const Document &other);
+        Document(Document &&) = default;
+        // Старые узлы должны разрушиться раньше, чем освободится память, в которой они лежат
+        Document &operator=(const Document &rhs);
+        Document &operator=(Document &&rhs);
+
         const Node &GetRoot() const;
+        // Корень для правки на месте. Копии документа правка не затрагивает: общие контейнеры
+        // на пути к изменённому значению копируются (см. Node::AsMutableArray). Документ из арены
+        // или с intern_keys при первом вызове целиком копируется в кучу, поэтому узлы, перемещённые
+        // из него, не зависят от памяти документа. Заимствованные строки по-прежнему ссылаются
+        // на входные данные (см. LoadOptions::borrow_strings)
+        Node &GetMutableRoot();
+        MemoryUsage GetMemoryUsage() const;
         bool operator==(const Document& rhs) const;
         bool operator!=(const Document& rhs) const;
     private:
+        // storage_ объявлен первым, чтобы разрушиться после узлов, которые на него ссылаются
+        std::shared_ptr<const void> storage_;
         Node root_;
     };
 
+    struct LoadOptions
+    {
+        // Строки без escape-последовательностей не копируются, а ссылаются на входные данные.
+        // Ключи словарей копируются всегда
+        bool borrow_strings = false;
+        // Ключи словарей хранятся в таблице документа, по одному экземпляру каждого
+        // (см. KeyTable). Повторяющиеся ключи не занимают памяти и сравниваются по указателю
+        bool intern_keys = false;
+        // Массивы и словари документа размещаются в монотонной арене, которая освобождается
+        // целиком вместе с документом. Копии узлов, взятые из документа, живут в обычной куче
+        bool use_arena = false;
+        // Двухфазный разбор: сначала SIMD-проход строит индекс значимых символов
+        // (см. structural_index.h), затем узлы строятся переходами по индексу
+        bool use_structural_index = false;
+        // Сколько потоков разбирают большой корневой массив (0 - по числу ядер).
+        // Массив режется между элементами, куски разбираются параллельно и склеиваются
+        // в исходном порядке. Результат и ошибки те же, что при последовательном разборе.
+        // Небольшие документы и документы с другим корнем всегда разбираются в одном потоке
+        size_t threads = 1;
+        // Наибольшая вложенность массивов и словарей (0 - без ограничения). По умолчанию 1000:
+        // документ с 1001 уровнем отвергается с ParsingError("Maximum nesting depth exceeded"),
+        // хотя раньше Load принимал любую вложенность. Разбор, вывод и разрушение не рекурсивны,
+        // но сравнение узлов, копирование из арены в кучу, SaveBinary и SaveSnapshot рекурсивны,
+        // поэтому враждебный вход вида [[[[... отвергается, а не роняет того, кто его читает.
+        // Документ, разобранный с 0, можно выводить и разрушать при любой глубине, а для
+        // остального нужен стек на всю его глубину
+        size_t max_depth = 1'000;
+        // Если задан, разбор заполняет счётчики (см. json_stats.h)
+        ParseStats *stats = nullptr;
+    };
+
+    // Разбирает JSON из непрерывного участка памяти
+    // При borrow_strings буфер должен пережить документ
+    Document Load(std::string_view input, const LoadOptions &options = {});
+    Document Load(const char *data, size_t size, const LoadOptions &options = {});
+    // Разбирает поток кусками по мере чтения. Символы после корневого значения остаются
+    // в потоке, поэтому документы, записанные подряд, читаются из него один за другим
     Document Load(std::istream &input);
+    // Отображает файл в память и разбирает его на месте.
+    // При borrow_strings отображение живёт столько же, сколько документ
+    Document LoadFile(const std::string &path, const LoadOptions &options = {});
+
+    enum class ParseStatus
+    {
+        // Документ ещё не закончился, нужны следующие куски
+        NeedMore,
+        // Корневое значение разобрано; всё, что придёт после него, не разбирается
+        Done,
+        // Вход не является JSON, текст ошибки - в GetError
+        Error,
+    };
+
+    // Разбор документа, который приходит кусками, например из неблокирующего сокета.
+    // Состояние разбора - явный стек открытых массивов и словарей, поэтому каждый кусок
+    // просматривается один раз, а токен, разрезанный границей куска, дочитывается из следующего.
+    // Куски не нужно хранить после Feed. borrow_strings не действует: строки всегда копируются
+    class IncrementalParser
+    {
+    public:
+        explicit IncrementalParser(const LoadOptions &options = {});
+        ~IncrementalParser();
+
+        IncrementalParser(IncrementalParser &&) noexcept;
+        IncrementalParser &operator=(IncrementalParser &&) noexcept;
+
+        ParseStatus Feed(std::string_view chunk);
+        // Сообщает о конце входа. Число или литерал в корне заканчиваются только здесь:
+        // по "12" нельзя понять, не придёт ли следом "3"
+        ParseStatus Finish();
+
+        ParseStatus GetStatus() const;
+        // Сколько байт последнего куска ушло на документ. Если на этом куске разбор закончился
+        // (Done), остаток куска - данные после корневого значения
+        size_t GetConsumed() const;
+        const std::string &GetError() const;
+        // Забирает документ после Done, один раз. Бросает std::logic_error, если разбор не закончен
+        Document TakeDocument();
 
-    void Print(const Document &doc, std::ostream &output);
-    void PrintEscape(const std::string &str, std::ostream &out);
+    private:
+        struct Impl;
+
+        std::unique_ptr<Impl> impl_;
+    };
+
+    struct PrintOptions
+    {
+        // Сколько потоков выводят большие массивы и словари (0 - по числу ядер).
+        // Текст не зависит от числа потоков, небольшие документы всегда выводятся в одном
+        size_t threads = 1;
+        // Если задан, вывод заполняет счётчики (см. json_stats.h)
+        PrintStats *stats = nullptr;
+    };
+
+    // Текст документа в том же формате, что и Print (см. json_writer.h)
+    std::string ToString(const Document &doc, const PrintOptions &options = {});
+    // Собирает текст в буфере и отдаёт его потоку одной записью
+    void Print(const Document &doc, std::ostream &output, const PrintOptions &options = {});
+    void PrintEscape(std::string_view str, std::ostream &out);
+
+    template <typename Visitor>
+    decltype(auto) Node::Visit(Visitor &&visitor) const
+    {
+        switch (type_)
+        {
+        case Type::Int:
+            return visitor(int_);
+        case Type::Double:
+            return visitor(double_);
+        case Type::String:
+            return visitor(static_cast<const std::string &>(string_->value));
+        case Type::Bool:
+            return visitor(bool_);
+        case Type::Array:
+            return visitor(static_cast<const Array &>(array_->value));
+        case Type::Dict:
+            return visitor(static_cast<const Dict &>(dict_->value));
+        case Type::BorrowedString:
+            return visitor(std::string_view(chars_, size_));
+        case Type::Int64:
+            return visitor(int64_);
+        case Type::Null:
+        default:
+            return visitor(nullptr);
+        }
+    }
 
 } // namespace json
\ No newline at end of file
@@ -0,0 +1,631 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "json.h"
+#include "json_lines.h"
+#include "json_validate.h"
+#include "json_writer.h"
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace json;
+using namespace std::literals;
+
+// Набор бенчмарков на синтетических корпусах. Для каждого корпуса выводит скорость разбора
+// и вывода, время на узел, число выделений памяти и пиковый объём резидентной памяти.
+// Запуск: json_bench [--size-mb N] [--repeat N] [--threads N] [--json FILE] [--baseline FILE]
+//   --size-mb   примерный размер каждого корпуса, по умолчанию 8
+//   --repeat    сколько раз повторить замер, берётся лучший, по умолчанию 5
+//   --threads   потоки разбора JSON Lines, по умолчанию 1
+//   --json      записать результаты в FILE, чтобы сравнивать прогоны между версиями
+//   --baseline  сравнить со скоростями из FILE, записанного через --json
+
+// Считаем выделения памяти так же, как main.cpp. Счётчик атомарный: JSON Lines
+// разбирается на нескольких потоках
+static std::atomic<size_t> allocation_count{0};
+
+// Все замены new и delete проходят через эту пару. BenchFree не встраивается, поэтому
+// компилятор не видит free рядом с operator new и не предупреждает о несовпадающих new и delete
+#if defined(__GNUC__)
+#define JSON_BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define JSON_BENCH_NOINLINE __declspec(noinline)
+#else
+#define JSON_BENCH_NOINLINE
+#endif
+
+static void *BenchAllocate(size_t size, size_t alignment) noexcept
+{
+    ++allocation_count;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        return std::malloc(size);
+    }
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+JSON_BENCH_NOINLINE static void BenchFree(void *ptr, size_t alignment) noexcept
+{
+#ifdef _MSC_VER
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        _aligned_free(ptr);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(ptr);
+}
+
+void *operator new(size_t size)
+{
+    if (void *ptr = BenchAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return BenchAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    BenchFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    BenchFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    BenchFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    if (void *ptr = BenchAllocate(size, static_cast<size_t>(align)))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr, std::align_val_t align) noexcept
+{
+    BenchFree(ptr, static_cast<size_t>(align));
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t align) noexcept
+{
+    BenchFree(ptr, static_cast<size_t>(align));
+}
+
+namespace
+{
+    struct BenchOptions
+    {
+        size_t size_mb = 8;
+        size_t repeat = 5;
+        size_t threads = 1;
+        std::string json_path;
+        std::string baseline_path;
+    };
+
+    struct Corpus
+    {
+        std::string name;
+        std::string text;
+        // По одному документу на строке, разбирается LoadLines
+        bool lines = false;
+    };
+
+    struct Result
+    {
+        std::string name;
+        size_t bytes = 0;
+        size_t printed_bytes = 0;
+        size_t nodes = 0;
+        double parse_seconds = 0;
+        double print_seconds = 0;
+        double validate_seconds = 0;
+        size_t parse_allocations = 0;
+        size_t print_allocations = 0;
+        // 0, если платформа не сообщает пиковый объём
+        size_t peak_rss_kb = 0;
+
+        double GetParseMbPerSecond() const
+        {
+            return bytes / parse_seconds / (1024 * 1024);
+        }
+
+        double GetPrintMbPerSecond() const
+        {
+            return printed_bytes / print_seconds / (1024 * 1024);
+        }
+
+        double GetValidateMbPerSecond() const
+        {
+            return bytes / validate_seconds / (1024 * 1024);
+        }
+
+        double GetParseNsPerNode() const
+        {
+            return parse_seconds * 1e9 / nodes;
+        }
+    };
+
+    // Корпуса генерируются с фиксированным зерном, чтобы прогоны были сравнимы
+    class CorpusGenerator
+    {
+    public:
+        explicit CorpusGenerator(size_t size)
+            : size_(size) {}
+
+        // Целые, дроби и числа с порядком
+        Corpus MakeNumbers()
+        {
+            Corpus corpus{"numbers"s, "["s};
+            std::uniform_int_distribution<int64_t> ints(-1'000'000'000'000LL, 1'000'000'000'000LL);
+            std::uniform_real_distribution<double> reals(-1e6, 1e6);
+            while (corpus.text.size() < size_)
+            {
+                AppendSeparator(corpus.text);
+                corpus.text += '[';
+                for (int i = 0; i < 8; ++i)
+                {
+                    if (i > 0)
+                    {
+                        corpus.text += ',';
+                    }
+                    switch (i % 4)
+                    {
+                    case 0:
+                        corpus.text += std::to_string(static_cast<int>(ints(random_) % 1000));
+                        break;
+                    case 1:
+                        corpus.text += std::to_string(ints(random_));
+                        break;
+                    case 2:
+                        corpus.text += ToText(reals(random_));
+                        break;
+                    default:
+                        corpus.text += ToText(reals(random_) * 1e-200);
+                        break;
+                    }
+                }
+                corpus.text += ']';
+            }
+            corpus.text += ']';
+            return corpus;
+        }
+
+        // Строки с escape-последовательностями, в том числе \\u и суррогатными парами
+        Corpus MakeStrings()
+        {
+            static constexpr std::string_view kPieces[] = {
+                "plain text "sv, "\\\"quoted\\\""sv, "back\\\\slash"sv, "line\\nbreak"sv, "tab\\t"sv,
+                "caf\\u00e9 "sv, "\\u20ac"sv, "\\ud83d\\ude00"sv, "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 "sv,
+            };
+            Corpus corpus{"strings"s, "["s};
+            std::uniform_int_distribution<size_t> piece(0, std::size(kPieces) - 1);
+            std::uniform_int_distribution<int> count(1, 12);
+            while (corpus.text.size() < size_)
+            {
+                AppendSeparator(corpus.text);
+                corpus.text += '"';
+                for (int i = count(random_); i > 0; --i)
+                {
+                    corpus.text += kPieces[piece(random_)];
+                }
+                corpus.text += '"';
+            }
+            corpus.text += ']';
+            return corpus;
+        }
+
+        // Цепочки вложенных массивов и словарей глубиной kDepth, в пределах LoadOptions::max_depth
+        Corpus MakeNested()
+        {
+            static constexpr int kDepth = 256;
+            Corpus corpus{"nested"s, "["s};
+            while (corpus.text.size() < size_)
+            {
+                AppendSeparator(corpus.text);
+                for (int level = 0; level < kDepth; ++level)
+                {
+                    corpus.text += level % 2 == 0 ? R"({"level":)"sv : "[true,"sv;
+                }
+                corpus.text += "null"sv;
+                for (int level = kDepth - 1; level >= 0; --level)
+                {
+                    corpus.text += level % 2 == 0 ? '}' : ']';
+                }
+            }
+            corpus.text += ']';
+            return corpus;
+        }
+
+        // Словари с сотнями ключей: проверяет сборку больших словарей и их индекс
+        Corpus MakeWideObjects()
+        {
+            static constexpr int kKeys = 500;
+            Corpus corpus{"wide_objects"s, "["s};
+            std::uniform_int_distribution<int> values(0, 1'000'000);
+            while (corpus.text.size() < size_)
+            {
+                AppendSeparator(corpus.text);
+                corpus.text += '{';
+                for (int key = 0; key < kKeys; ++key)
+                {
+                    if (key > 0)
+                    {
+                        corpus.text += ',';
+                    }
+                    corpus.text += "\"field_"sv;
+                    corpus.text += std::to_string(key);
+                    corpus.text += "\":"sv;
+                    corpus.text += std::to_string(values(random_));
+                }
+                corpus.text += '}';
+            }
+            corpus.text += ']';
+            return corpus;
+        }
+
+        // Записи JSON Lines, похожие на журнал событий
+        Corpus MakeLines()
+        {
+            Corpus corpus{"ndjson"s, {}, true};
+            std::uniform_int_distribution<int> users(0, 100'000);
+            std::uniform_real_distribution<double> scores(0, 100);
+            for (size_t id = 0; corpus.text.size() < size_; ++id)
+            {
+                corpus.text += R"({"id":)"sv;
+                corpus.text += std::to_string(id);
+                corpus.text += R"(,"user":"user_)"sv;
+                corpus.text += std::to_string(users(random_));
+                corpus.text += R"(","event":"click","score":)"sv;
+                corpus.text += ToText(scores(random_));
+                corpus.text += R"(,"active":true,"tags":["web","mobile"],"meta":{"version":3,"ref":null}})"sv;
+                corpus.text += '\n';
+            }
+            return corpus;
+        }
+
+    private:
+        static void AppendSeparator(std::string &text)
+        {
+            if (text.size() > 1)
+            {
+                text += ',';
+            }
+        }
+
+        static std::string ToText(double value)
+        {
+            Writer writer;
+            writer.WriteDouble(value);
+            return writer.TakeData();
+        }
+
+        size_t size_;
+        std::mt19937_64 random_{42};
+    };
+
+    // Сбрасывает пиковый объём резидентной памяти, если система это позволяет.
+    // Иначе пик считается от запуска процесса
+    void ResetPeakRss()
+    {
+#ifdef __linux__
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+#endif
+    }
+
+    size_t GetPeakRssKb()
+    {
+#if defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:"sv) == 0)
+            {
+                return static_cast<size_t>(std::strtoull(line.c_str() + 6, nullptr, 10));
+            }
+        }
+        return 0;
+#elif !defined(_WIN32)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+        return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    double GetSeconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    // Разбор и вывод повторяются repeat раз, в результат идёт лучшее время.
+    // Документы разрушаются вне замера
+    Result RunCorpus(const Corpus &corpus, const BenchOptions &options)
+    {
+        Result result;
+        result.name = corpus.name;
+        result.bytes = corpus.text.size();
+        ResetPeakRss();
+
+        std::vector<Document> docs;
+        for (size_t run = 0; run < options.repeat; ++run)
+        {
+            docs.clear();
+            docs.reserve(1);
+            const size_t allocations_before = allocation_count;
+            const auto start = std::chrono::steady_clock::now();
+            if (corpus.lines)
+            {
+                docs = LoadLines(corpus.text, {}, options.threads);
+            }
+            else
+            {
+                docs.push_back(Load(corpus.text));
+            }
+            const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+            result.parse_allocations = allocation_count - allocations_before;
+            result.parse_seconds = run == 0 ? seconds : std::min(result.parse_seconds, seconds);
+        }
+        for (const Document &doc : docs)
+        {
+            result.nodes += doc.GetMemoryUsage().nodes;
+        }
+
+        for (size_t run = 0; run < options.repeat; ++run)
+        {
+            const size_t allocations_before = allocation_count;
+            const auto start = std::chrono::steady_clock::now();
+            std::string text;
+            Writer writer(text);
+            for (const Document &doc : docs)
+            {
+                writer.WriteNode(doc.GetRoot());
+                if (corpus.lines)
+                {
+                    writer.WriteRaw("\n"sv);
+                }
+            }
+            const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+            result.print_allocations = allocation_count - allocations_before;
+            result.print_seconds = run == 0 ? seconds : std::min(result.print_seconds, seconds);
+            result.printed_bytes = text.size();
+        }
+
+        // Проверка без построения документа; записи NDJSON проверяются по одной
+        for (size_t run = 0; run < options.repeat; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            bool valid = true;
+            if (corpus.lines)
+            {
+                std::string_view rest = corpus.text;
+                while (!rest.empty())
+                {
+                    const size_t line_end = std::min(rest.find('\n'), rest.size());
+                    valid = valid && Validate(rest.substr(0, line_end)).IsValid();
+                    rest.remove_prefix(std::min(line_end + 1, rest.size()));
+                }
+            }
+            else
+            {
+                valid = Validate(corpus.text).IsValid();
+            }
+            const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+            if (!valid)
+            {
+                throw std::runtime_error("Corpus "s + corpus.name + " is not valid JSON"s);
+            }
+            result.validate_seconds = run == 0 ? seconds : std::min(result.validate_seconds, seconds);
+        }
+        result.peak_rss_kb = GetPeakRssKb();
+        return result;
+    }
+
+    void PrintTable(const std::vector<Result> &results)
+    {
+        std::cout << std::left << std::setw(14) << "corpus"sv << std::right
+                  << std::setw(10) << "MB"sv
+                  << std::setw(12) << "parse MB/s"sv
+                  << std::setw(12) << "print MB/s"sv
+                  << std::setw(14) << "validate MB/s"sv
+                  << std::setw(10) << "ns/node"sv
+                  << std::setw(14) << "parse allocs"sv
+                  << std::setw(14) << "print allocs"sv
+                  << std::setw(14) << "peak RSS MB"sv << '\n';
+        std::cout << std::fixed << std::setprecision(1);
+        for (const Result &result : results)
+        {
+            std::cout << std::left << std::setw(14) << result.name << std::right
+                      << std::setw(10) << result.bytes / (1024.0 * 1024)
+                      << std::setw(12) << result.GetParseMbPerSecond()
+                      << std::setw(12) << result.GetPrintMbPerSecond()
+                      << std::setw(14) << result.GetValidateMbPerSecond()
+                      << std::setw(10) << result.GetParseNsPerNode()
+                      << std::setw(14) << result.parse_allocations
+                      << std::setw(14) << result.print_allocations
+                      << std::setw(14) << result.peak_rss_kb / 1024.0 << '\n';
+        }
+        std::cout << std::defaultfloat;
+    }
+
+    Node ToNode(const Result &result)
+    {
+        return Dict{
+            {"name"s, result.name},
+            {"bytes"s, static_cast<int64_t>(result.bytes)},
+            {"nodes"s, static_cast<int64_t>(result.nodes)},
+            {"parse_mb_s"s, result.GetParseMbPerSecond()},
+            {"print_mb_s"s, result.GetPrintMbPerSecond()},
+            {"validate_mb_s"s, result.GetValidateMbPerSecond()},
+            {"parse_ns_per_node"s, result.GetParseNsPerNode()},
+            {"parse_allocations"s, static_cast<int64_t>(result.parse_allocations)},
+            {"print_allocations"s, static_cast<int64_t>(result.print_allocations)},
+            {"peak_rss_kb"s, static_cast<int64_t>(result.peak_rss_kb)},
+        };
+    }
+
+    void WriteResults(const std::vector<Result> &results, const BenchOptions &options)
+    {
+        Array corpora;
+        for (const Result &result : results)
+        {
+            corpora.push_back(ToNode(result));
+        }
+        const Document doc{Dict{
+            {"size_mb"s, static_cast<int64_t>(options.size_mb)},
+            {"repeat"s, static_cast<int64_t>(options.repeat)},
+            {"threads"s, static_cast<int64_t>(options.threads)},
+            {"corpora"s, std::move(corpora)},
+        }};
+        std::ofstream out(options.json_path, std::ios::binary);
+        Print(doc, out);
+        out << '\n';
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write "s + options.json_path);
+        }
+    }
+
+    // Изменение скоростей относительно прошлого прогона, в процентах
+    void CompareWithBaseline(const std::vector<Result> &results, const std::string &path)
+    {
+        const Document baseline = LoadFile(path);
+        const Dict &root = baseline.GetRoot().AsMap();
+        std::cout << "Compared with "sv << path << ":\n"sv << std::showpos << std::fixed << std::setprecision(1);
+        for (const Node &old : root.at("corpora"sv).AsArray())
+        {
+            const Dict &fields = old.AsMap();
+            const auto it = std::find_if(results.begin(), results.end(), [&fields](const Result &result)
+                                         { return result.name == fields.at("name"sv).AsString(); });
+            if (it == results.end())
+            {
+                continue;
+            }
+            const auto change = [](double now, double before)
+            {
+                return (now / before - 1) * 100;
+            };
+            std::cout << std::left << std::setw(14) << it->name << std::right
+                      << " parse "sv << change(it->GetParseMbPerSecond(), fields.at("parse_mb_s"sv).AsDouble()) << '%'
+                      << ", print "sv << change(it->GetPrintMbPerSecond(), fields.at("print_mb_s"sv).AsDouble()) << '%';
+            // В базовых замерах старых версий проверки ещё нет
+            if (fields.count("validate_mb_s"sv) != 0)
+            {
+                std::cout << ", validate "sv << change(it->GetValidateMbPerSecond(), fields.at("validate_mb_s"sv).AsDouble()) << '%';
+            }
+            std::cout << '\n';
+        }
+        std::cout << std::noshowpos << std::defaultfloat;
+    }
+
+    BenchOptions ParseArguments(int argc, char **argv)
+    {
+        BenchOptions options;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (i + 1 == argc)
+            {
+                throw std::invalid_argument("Missing value for "s + std::string(arg));
+            }
+            const char *value = argv[++i];
+            if (arg == "--size-mb"sv)
+            {
+                options.size_mb = std::stoul(value);
+            }
+            else if (arg == "--repeat"sv)
+            {
+                options.repeat = std::max<size_t>(1, std::stoul(value));
+            }
+            else if (arg == "--threads"sv)
+            {
+                options.threads = std::stoul(value);
+            }
+            else if (arg == "--json"sv)
+            {
+                options.json_path = value;
+            }
+            else if (arg == "--baseline"sv)
+            {
+                options.baseline_path = value;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option "s + std::string(arg));
+            }
+        }
+        return options;
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const BenchOptions options = ParseArguments(argc, argv);
+        std::vector<Result> results;
+        {
+            CorpusGenerator generator(options.size_mb * 1024 * 1024);
+            for (const auto make : {&CorpusGenerator::MakeNumbers, &CorpusGenerator::MakeStrings, &CorpusGenerator::MakeNested,
+                                    &CorpusGenerator::MakeWideObjects, &CorpusGenerator::MakeLines})
+            {
+                const Corpus corpus = (generator.*make)();
+                results.push_back(RunCorpus(corpus, options));
+            }
+        }
+        PrintTable(results);
+        if (!options.json_path.empty())
+        {
+            WriteResults(results, options);
+        }
+        if (!options.baseline_path.empty())
+        {
+            CompareWithBaseline(results, options.baseline_path);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
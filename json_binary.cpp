@@ -0,0 +1,444 @@
+#include "json_binary.h"
+#include "json_parser.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Маркеры MessagePack. Числа в заголовках записываются в порядке big-endian
+        enum Marker : uint8_t
+        {
+            kPositiveFixIntMax = 0x7f,
+            kFixMap = 0x80,
+            kFixArray = 0x90,
+            kFixStr = 0xa0,
+            kNil = 0xc0,
+            kFalse = 0xc2,
+            kTrue = 0xc3,
+            kFloat32 = 0xca,
+            kFloat64 = 0xcb,
+            kUint8 = 0xcc,
+            kUint16 = 0xcd,
+            kUint32 = 0xce,
+            kUint64 = 0xcf,
+            kInt8 = 0xd0,
+            kInt16 = 0xd1,
+            kInt32 = 0xd2,
+            kInt64 = 0xd3,
+            kStr8 = 0xd9,
+            kStr16 = 0xda,
+            kStr32 = 0xdb,
+            kArray16 = 0xdc,
+            kArray32 = 0xdd,
+            kMap16 = 0xde,
+            kMap32 = 0xdf,
+            kNegativeFixIntMin = 0xe0,
+        };
+
+        class BinaryWriter
+        {
+        public:
+            explicit BinaryWriter(std::string &buffer)
+                : buffer_(buffer) {}
+
+            void WriteNode(const Node &node)
+            {
+                node.Visit([this](const auto &value)
+                           {
+                    using Value = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<Value, std::nullptr_t>)
+                    {
+                        WriteByte(kNil);
+                    }
+                    else if constexpr (std::is_same_v<Value, bool>)
+                    {
+                        WriteByte(value ? kTrue : kFalse);
+                    }
+                    else if constexpr (std::is_same_v<Value, int> || std::is_same_v<Value, int64_t>)
+                    {
+                        WriteInt(value);
+                    }
+                    else if constexpr (std::is_same_v<Value, double>)
+                    {
+                        uint64_t bits;
+                        std::memcpy(&bits, &value, sizeof(bits));
+                        WriteByte(kFloat64);
+                        WriteBigEndian(bits, 8);
+                    }
+                    else if constexpr (std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+                    {
+                        WriteString(value);
+                    }
+                    else if constexpr (std::is_same_v<Value, Array>)
+                    {
+                        WriteContainerHeader(value.size(), kFixArray, kArray16, kArray32);
+                        for (const Node &item : value)
+                        {
+                            WriteNode(item);
+                        }
+                    }
+                    else if constexpr (std::is_same_v<Value, Dict>)
+                    {
+                        WriteContainerHeader(value.size(), kFixMap, kMap16, kMap32);
+                        for (const auto &[key, item] : value)
+                        {
+                            WriteString(key);
+                            WriteNode(item);
+                        }
+                    } });
+            }
+
+        private:
+            void WriteByte(uint8_t byte)
+            {
+                buffer_.push_back(static_cast<char>(byte));
+            }
+
+            void WriteBigEndian(uint64_t value, int bytes)
+            {
+                char data[8];
+                for (int i = bytes - 1; i >= 0; --i)
+                {
+                    data[i] = static_cast<char>(value & 0xff);
+                    value >>= 8;
+                }
+                buffer_.append(data, static_cast<size_t>(bytes));
+            }
+
+            // Самое короткое представление целого
+            void WriteInt(int64_t value)
+            {
+                if (value >= 0)
+                {
+                    if (value <= kPositiveFixIntMax)
+                    {
+                        WriteByte(static_cast<uint8_t>(value));
+                    }
+                    else if (value <= std::numeric_limits<uint8_t>::max())
+                    {
+                        WriteByte(kUint8);
+                        WriteBigEndian(static_cast<uint64_t>(value), 1);
+                    }
+                    else if (value <= std::numeric_limits<uint16_t>::max())
+                    {
+                        WriteByte(kUint16);
+                        WriteBigEndian(static_cast<uint64_t>(value), 2);
+                    }
+                    else if (value <= std::numeric_limits<uint32_t>::max())
+                    {
+                        WriteByte(kUint32);
+                        WriteBigEndian(static_cast<uint64_t>(value), 4);
+                    }
+                    else
+                    {
+                        WriteByte(kInt64);
+                        WriteBigEndian(static_cast<uint64_t>(value), 8);
+                    }
+                }
+                else if (value >= -32)
+                {
+                    WriteByte(static_cast<uint8_t>(value));
+                }
+                else if (value >= std::numeric_limits<int8_t>::min())
+                {
+                    WriteByte(kInt8);
+                    WriteBigEndian(static_cast<uint64_t>(value), 1);
+                }
+                else if (value >= std::numeric_limits<int16_t>::min())
+                {
+                    WriteByte(kInt16);
+                    WriteBigEndian(static_cast<uint64_t>(value), 2);
+                }
+                else if (value >= std::numeric_limits<int32_t>::min())
+                {
+                    WriteByte(kInt32);
+                    WriteBigEndian(static_cast<uint64_t>(value), 4);
+                }
+                else
+                {
+                    WriteByte(kInt64);
+                    WriteBigEndian(static_cast<uint64_t>(value), 8);
+                }
+            }
+
+            void WriteString(std::string_view value)
+            {
+                if (value.size() < 32)
+                {
+                    WriteByte(static_cast<uint8_t>(kFixStr | value.size()));
+                }
+                else if (value.size() <= std::numeric_limits<uint8_t>::max())
+                {
+                    WriteByte(kStr8);
+                    WriteBigEndian(value.size(), 1);
+                }
+                else
+                {
+                    WriteSize(value.size(), kStr16, kStr32);
+                }
+                buffer_.append(value);
+            }
+
+            // Заголовок контейнера: меньше 16 элементов помещаются в сам маркер
+            void WriteContainerHeader(size_t size, uint8_t fix_marker, uint8_t marker16, uint8_t marker32)
+            {
+                if (size < 16)
+                {
+                    WriteByte(static_cast<uint8_t>(fix_marker | size));
+                }
+                else
+                {
+                    WriteSize(size, marker16, marker32);
+                }
+            }
+
+            void WriteSize(size_t size, uint8_t marker16, uint8_t marker32)
+            {
+                if (size <= std::numeric_limits<uint16_t>::max())
+                {
+                    WriteByte(marker16);
+                    WriteBigEndian(size, 2);
+                }
+                else if (size <= std::numeric_limits<uint32_t>::max())
+                {
+                    WriteByte(marker32);
+                    WriteBigEndian(size, 4);
+                }
+                else
+                {
+                    throw std::length_error("Value is too large for MessagePack");
+                }
+            }
+
+            std::string &buffer_;
+        };
+
+        class BinaryReader
+        {
+        public:
+            BinaryReader(std::string_view data, size_t max_depth)
+                : pos_(data.data()), end_(data.data() + data.size()), max_depth_(max_depth) {}
+
+            Node ReadNode()
+            {
+                const uint8_t marker = ReadByte();
+                if (marker <= kPositiveFixIntMax)
+                {
+                    return Node(static_cast<int>(marker));
+                }
+                if (marker >= kNegativeFixIntMin)
+                {
+                    return Node(static_cast<int>(static_cast<int8_t>(marker)));
+                }
+                if ((marker & 0xf0) == kFixMap)
+                {
+                    return ReadDict(marker & 0x0f);
+                }
+                if ((marker & 0xf0) == kFixArray)
+                {
+                    return ReadArray(marker & 0x0f);
+                }
+                if ((marker & 0xe0) == kFixStr)
+                {
+                    return Node(std::string(ReadBytes(marker & 0x1f)));
+                }
+                switch (marker)
+                {
+                case kNil:
+                    return Node(nullptr);
+                case kFalse:
+                    return Node(false);
+                case kTrue:
+                    return Node(true);
+                case kFloat32:
+                {
+                    const auto bits = static_cast<uint32_t>(ReadBigEndian(4));
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    return Node(static_cast<double>(value));
+                }
+                case kFloat64:
+                {
+                    const uint64_t bits = ReadBigEndian(8);
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    return Node(value);
+                }
+                case kUint8:
+                    return Node(static_cast<int64_t>(ReadBigEndian(1)));
+                case kUint16:
+                    return Node(static_cast<int64_t>(ReadBigEndian(2)));
+                case kUint32:
+                    return Node(static_cast<int64_t>(ReadBigEndian(4)));
+                case kUint64:
+                {
+                    const uint64_t value = ReadBigEndian(8);
+                    if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+                    {
+                        return Node(static_cast<double>(value));
+                    }
+                    return Node(static_cast<int64_t>(value));
+                }
+                case kInt8:
+                    return Node(static_cast<int64_t>(static_cast<int8_t>(ReadBigEndian(1))));
+                case kInt16:
+                    return Node(static_cast<int64_t>(static_cast<int16_t>(ReadBigEndian(2))));
+                case kInt32:
+                    return Node(static_cast<int64_t>(static_cast<int32_t>(ReadBigEndian(4))));
+                case kInt64:
+                    return Node(static_cast<int64_t>(ReadBigEndian(8)));
+                case kStr8:
+                case kStr16:
+                case kStr32:
+                    return Node(std::string(ReadBytes(ReadStringSize(marker))));
+                case kArray16:
+                    return ReadArray(ReadBigEndian(2));
+                case kArray32:
+                    return ReadArray(ReadBigEndian(4));
+                case kMap16:
+                    return ReadDict(ReadBigEndian(2));
+                case kMap32:
+                    return ReadDict(ReadBigEndian(4));
+                default:
+                    throw ParsingError("Unsupported MessagePack type");
+                }
+            }
+
+            bool IsDone() const
+            {
+                return pos_ == end_;
+            }
+
+        private:
+            uint8_t ReadByte()
+            {
+                if (pos_ == end_)
+                {
+                    throw ParsingError("Unexpected end of input");
+                }
+                return static_cast<uint8_t>(*pos_++);
+            }
+
+            uint64_t ReadBigEndian(int bytes)
+            {
+                CheckAvailable(static_cast<uint64_t>(bytes));
+                uint64_t value = 0;
+                for (int i = 0; i < bytes; ++i)
+                {
+                    value = (value << 8) | static_cast<uint8_t>(*pos_++);
+                }
+                return value;
+            }
+
+            std::string_view ReadBytes(uint64_t size)
+            {
+                CheckAvailable(size);
+                const std::string_view bytes(pos_, static_cast<size_t>(size));
+                pos_ += size;
+                return bytes;
+            }
+
+            uint64_t ReadStringSize(uint8_t marker)
+            {
+                if (marker == kStr8)
+                {
+                    return ReadBigEndian(1);
+                }
+                return ReadBigEndian(marker == kStr16 ? 2 : 4);
+            }
+
+            std::string_view ReadKey()
+            {
+                const uint8_t marker = ReadByte();
+                if ((marker & 0xe0) == kFixStr)
+                {
+                    return ReadBytes(marker & 0x1f);
+                }
+                if (marker == kStr8 || marker == kStr16 || marker == kStr32)
+                {
+                    return ReadBytes(ReadStringSize(marker));
+                }
+                throw ParsingError("Dictionary key must be a string");
+            }
+
+            void CheckAvailable(uint64_t size) const
+            {
+                if (size > static_cast<uint64_t>(end_ - pos_))
+                {
+                    throw ParsingError("Unexpected end of input");
+                }
+            }
+
+            Node ReadArray(uint64_t size)
+            {
+                // Каждый элемент занимает хотя бы байт, так что испорченный заголовок
+                // не заставит выделить память больше, чем размер входа
+                CheckAvailable(size);
+                // Контейнеры читаются рекурсивно, поэтому глубина ограничена, как и в тексте
+                detail::CheckDepth(depth_++, max_depth_);
+                Array array;
+                array.reserve(static_cast<size_t>(size));
+                for (uint64_t i = 0; i < size; ++i)
+                {
+                    array.push_back(ReadNode());
+                }
+                --depth_;
+                return Node(move(array));
+            }
+
+            Node ReadDict(uint64_t size)
+            {
+                CheckAvailable(size * 2);
+                detail::CheckDepth(depth_++, max_depth_);
+                Dict::Entries entries;
+                entries.reserve(static_cast<size_t>(size));
+                for (uint64_t i = 0; i < size; ++i)
+                {
+                    Key key(ReadKey());
+                    entries.emplace_back(move(key), ReadNode());
+                }
+                --depth_;
+                return Node(Dict(move(entries)));
+            }
+
+            const char *pos_;
+            const char *end_;
+            size_t max_depth_;
+            // Сколько контейнеров открыто
+            size_t depth_ = 0;
+        };
+
+    } // namespace
+
+    std::string SaveBinary(const Document &doc)
+    {
+        std::string buffer;
+        SaveBinary(doc, buffer);
+        return buffer;
+    }
+
+    void SaveBinary(const Document &doc, std::string &buffer)
+    {
+        BinaryWriter writer(buffer);
+        writer.WriteNode(doc.GetRoot());
+    }
+
+    Document LoadBinary(std::string_view data, const LoadOptions &options)
+    {
+        BinaryReader reader(data, options.max_depth);
+        Node root = reader.ReadNode();
+        if (!reader.IsDone())
+        {
+            throw ParsingError("Redundant data after document");
+        }
+        return Document{move(root)};
+    }
+
+} // namespace json
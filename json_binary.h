@@ -0,0 +1,26 @@
+#pragma once
+
+#include "json.h"
+
+#include <string>
+#include <string_view>
+
+namespace json
+{
+    // Двоичное представление документа в формате MessagePack (https://msgpack.org).
+    // Узлы отображаются без потерь: null, bool, целые - самым коротким целым типом,
+    // double - всегда float64, чтобы 1.0 осталось вещественным, строки и ключи - str,
+    // массивы и словари - array и map с числом элементов в заголовке.
+    // Заимствованная строка записывается как обычная
+    std::string SaveBinary(const Document &doc);
+    // Дописывает представление в конец buffer, чтобы память буфера переиспользовалась
+    void SaveBinary(const Document &doc, std::string &buffer);
+
+    // Читает документ, записанный SaveBinary или другой реализацией MessagePack.
+    // Размеры массивов и словарей известны заранее, поэтому память под элементы выделяется
+    // один раз. Целое больше INT64_MAX читается как double, как и в тексте. Ключи словарей
+    // должны быть строками; bin, ext и данные после корневого значения приводят к ParsingError.
+    // Из options учитывается только max_depth
+    Document LoadBinary(std::string_view data, const LoadOptions &options = {});
+
+} // namespace json
@@ -0,0 +1,295 @@
+#include "json_builder.h"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace json
+{
+    Builder::Builder(std::pmr::memory_resource *resource)
+        : resource_(resource) {}
+
+    Builder::Builder(Writer &writer)
+        : resource_(std::pmr::get_default_resource()), writer_(&writer) {}
+
+    Builder &Builder::StartDict(size_t reserve)
+    {
+        BeforeValue();
+        Frame &frame = PushFrame(false);
+        if (writer_ != nullptr)
+        {
+            writer_->WriteRaw("{ "sv);
+        }
+        else
+        {
+            frame.entries.reserve(reserve);
+        }
+        return *this;
+    }
+
+    Builder &Builder::EndDict()
+    {
+        Frame &frame = PopFrame(false);
+        if (writer_ != nullptr)
+        {
+            writer_->WriteRaw(" }"sv);
+            return *this;
+        }
+        // Пары собираются как есть, а сортируются один раз при создании словаря
+        Add(Node(Dict(move(frame.entries))));
+        frame.entries.clear();
+        return *this;
+    }
+
+    Builder &Builder::StartArray(size_t reserve)
+    {
+        BeforeValue();
+        Frame &frame = PushFrame(true);
+        if (writer_ != nullptr)
+        {
+            writer_->WriteRaw("["sv);
+        }
+        else
+        {
+            frame.array.reserve(reserve);
+        }
+        return *this;
+    }
+
+    Builder &Builder::EndArray()
+    {
+        Frame &frame = PopFrame(true);
+        if (writer_ != nullptr)
+        {
+            writer_->WriteRaw("]"sv);
+            return *this;
+        }
+        Add(Node(move(frame.array)));
+        frame.array.clear();
+        return *this;
+    }
+
+    Builder &Builder::Key(std::string_view key)
+    {
+        if (depth_ == 0 || frames_[depth_ - 1].is_array || frames_[depth_ - 1].has_key)
+        {
+            throw std::logic_error("Key is allowed only inside a dictionary, before a value");
+        }
+        Frame &frame = frames_[depth_ - 1];
+        frame.has_key = true;
+        if (writer_ != nullptr)
+        {
+            if (frame.count++ > 0)
+            {
+                writer_->WriteRaw(" , "sv);
+            }
+            writer_->WriteString(key);
+            writer_->WriteRaw(" : "sv);
+        }
+        else
+        {
+            frame.key = json::Key(key);
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(std::nullptr_t)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteNull();
+        }
+        else
+        {
+            Add(Node(nullptr));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(bool value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteBool(value);
+        }
+        else
+        {
+            Add(Node(value));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(int value)
+    {
+        return Value(static_cast<int64_t>(value));
+    }
+
+    Builder &Builder::Value(int64_t value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteInt(value);
+        }
+        else
+        {
+            Add(Node(value));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(double value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteDouble(value);
+        }
+        else
+        {
+            Add(Node(value));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(std::string_view value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteString(value);
+        }
+        else
+        {
+            Add(Node(std::string(value), resource_));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(const char *value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    Builder &Builder::Value(std::string value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteString(value);
+        }
+        else
+        {
+            Add(Node(move(value), resource_));
+        }
+        return *this;
+    }
+
+    Builder &Builder::Value(Node value)
+    {
+        BeforeValue();
+        if (writer_ != nullptr)
+        {
+            writer_->WriteNode(value);
+        }
+        else
+        {
+            Add(move(value));
+        }
+        return *this;
+    }
+
+    bool Builder::IsDone() const
+    {
+        return has_root_ && depth_ == 0;
+    }
+
+    Node Builder::Build()
+    {
+        if (writer_ != nullptr)
+        {
+            throw std::logic_error("Builder writes into Writer and has no node");
+        }
+        if (!IsDone())
+        {
+            throw std::logic_error("Document is not complete");
+        }
+        has_root_ = false;
+        return move(root_);
+    }
+
+    void Builder::BeforeValue()
+    {
+        if (depth_ == 0)
+        {
+            if (has_root_)
+            {
+                throw std::logic_error("Document already has a root value");
+            }
+            has_root_ = true;
+            return;
+        }
+        Frame &frame = frames_[depth_ - 1];
+        if (frame.is_array)
+        {
+            if (writer_ != nullptr && frame.count++ > 0)
+            {
+                writer_->WriteRaw(","sv);
+            }
+            return;
+        }
+        if (!frame.has_key)
+        {
+            throw std::logic_error("Key is expected before a dictionary value");
+        }
+        frame.has_key = false;
+    }
+
+    void Builder::Add(Node node)
+    {
+        if (depth_ == 0)
+        {
+            root_ = move(node);
+            return;
+        }
+        Frame &frame = frames_[depth_ - 1];
+        if (frame.is_array)
+        {
+            frame.array.push_back(move(node));
+        }
+        else
+        {
+            frame.entries.emplace_back(move(frame.key), move(node));
+        }
+    }
+
+    Builder::Frame &Builder::PushFrame(bool is_array)
+    {
+        if (depth_ == frames_.size())
+        {
+            frames_.emplace_back(resource_);
+        }
+        Frame &frame = frames_[depth_++];
+        frame.is_array = is_array;
+        frame.has_key = false;
+        frame.count = 0;
+        return frame;
+    }
+
+    Builder::Frame &Builder::PopFrame(bool is_array)
+    {
+        if (depth_ == 0 || frames_[depth_ - 1].is_array != is_array)
+        {
+            throw std::logic_error(is_array ? "EndArray without StartArray" : "EndDict without StartDict");
+        }
+        if (frames_[depth_ - 1].has_key)
+        {
+            throw std::logic_error("Value is expected after key");
+        }
+        return frames_[--depth_];
+    }
+
+} // namespace json
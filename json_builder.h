@@ -0,0 +1,92 @@
+#pragma once
+
+#include "json.h"
+#include "json_writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+    // Построение документа без промежуточных объектов:
+    //   Builder builder;
+    //   builder.StartDict(2).Key("id"sv).Value(42).Key("tags"sv).StartArray().Value("a"sv).EndArray().EndDict();
+    //   Node node = builder.Build();
+    // Ключи принимаются как string_view и не копируются в std::string, значения сразу
+    // попадают в контейнер-родитель, контейнеры переносятся, а не копируются. Размер,
+    // переданный в StartDict/StartArray, резервируется заранее.
+    // Builder(writer) не создаёт узлов вовсе: текст сразу дописывается в буфер Writer
+    // в том же формате, что и WriteNode, только ключи идут в порядке вызовов Key
+    // и повторы не отбрасываются.
+    // Нарушение порядка вызовов (значение в словаре без ключа, лишняя закрывающая скобка,
+    // второе корневое значение) приводит к std::logic_error
+    class Builder
+    {
+    public:
+        // Контейнеры берут память из resource
+        explicit Builder(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+        explicit Builder(Writer &writer);
+
+        Builder(const Builder &) = delete;
+        Builder &operator=(const Builder &) = delete;
+
+        // reserve - ожидаемое число элементов
+        Builder &StartDict(size_t reserve = 0);
+        Builder &EndDict();
+        Builder &StartArray(size_t reserve = 0);
+        Builder &EndArray();
+        Builder &Key(std::string_view key);
+
+        Builder &Value(std::nullptr_t);
+        Builder &Value(bool value);
+        Builder &Value(int value);
+        Builder &Value(int64_t value);
+        Builder &Value(double value);
+        Builder &Value(std::string_view value);
+        Builder &Value(const char *value);
+        Builder &Value(std::string value);
+        // Готовый узел переносится в документ, при выводе в Writer - записывается
+        Builder &Value(Node value);
+
+        // Корневое значение записано и все контейнеры закрыты
+        bool IsDone() const;
+        // Забирает построенный узел; после этого можно строить следующий.
+        // Для Builder(writer) всегда бросает std::logic_error
+        Node Build();
+
+    private:
+        struct Frame
+        {
+            explicit Frame(std::pmr::memory_resource *resource)
+                : array(resource), entries(resource) {}
+
+            bool is_array = true;
+            // Ключ уже задан, ждём значение
+            bool has_key = false;
+            // Сколько элементов уже записано в Writer
+            size_t count = 0;
+            Array array;
+            Dict::Entries entries;
+            json::Key key;
+        };
+
+        // Проверяет, что значение сейчас уместно, и пишет разделитель перед ним
+        void BeforeValue();
+        void Add(Node node);
+        Frame &PushFrame(bool is_array);
+        Frame &PopFrame(bool is_array);
+
+        std::pmr::memory_resource *resource_;
+        Writer *writer_ = nullptr;
+        // Кадры переиспользуются следующими контейнерами той же глубины
+        std::vector<Frame> frames_;
+        size_t depth_ = 0;
+        bool has_root_ = false;
+        Node root_;
+    };
+
+} // namespace json
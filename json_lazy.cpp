@@ -0,0 +1,443 @@
+#include "json_lazy.h"
+#include "json_parser.h"
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Собирает узел из единственного события разбора числа или литерала
+        struct ScalarBuilder
+        {
+            void OnNull()
+            {
+                value = Node(nullptr);
+            }
+            void OnBool(bool v)
+            {
+                value = Node(v);
+            }
+            void OnInt(int64_t v)
+            {
+                value = Node(v);
+            }
+            void OnDouble(double v)
+            {
+                value = Node(v);
+            }
+
+            Node value;
+        };
+
+        // Проверяет, что в pos начинается значение. Иначе пропуск не сдвинулся бы с места
+        const char *CheckValueStart(const char *pos, const char *end, const char *error)
+        {
+            if (pos == end)
+            {
+                throw ParsingError(error);
+            }
+            const char c = *pos;
+            if (c != '"' && c != '[' && c != '{' && c != 'n' && c != 't' && c != 'f' && !detail::IsNumberStart(c))
+            {
+                throw ParsingError("Unexpected symbol");
+            }
+            return pos;
+        }
+
+        // Пропускает пробелы и запятую перед следующим элементом. Возвращает nullptr,
+        // если встретилась закрывающая скобка. Как и в Load, перед первым элементом (first)
+        // запятой быть не может, а перед остальными она обязательна
+        const char *SkipSeparator(const char *pos, const char *end, char close, bool first, const char *error)
+        {
+            pos = detail::SkipSpace(pos, end);
+            if (pos == end)
+            {
+                throw ParsingError(error);
+            }
+            if (*pos == close)
+            {
+                return nullptr;
+            }
+            if (!first)
+            {
+                if (*pos != ',')
+                {
+                    throw ParsingError(close == ']' ? "Expected ',' or ']'" : "Expected ',' or '}'");
+                }
+                pos = detail::SkipSpace(pos + 1, end);
+            }
+            return pos;
+        }
+
+        std::string DecodeString(const char *pos, const char *end)
+        {
+            std::string result;
+            detail::StringEscape escape;
+            if (!detail::DecodeString(pos, end, result, escape))
+            {
+                throw ParsingError("String parsing error");
+            }
+            return result;
+        }
+
+    } // namespace
+
+    LazyNode::LazyNode(const char *pos, const char *end)
+        : pos_(pos), end_(end) {}
+
+    Node LazyNode::LoadScalar() const
+    {
+        const char c = *pos_;
+        if (c == '"')
+        {
+            return Node(DecodeString(pos_ + 1, end_));
+        }
+        if (c == '[' || c == '{')
+        {
+            throw std::logic_error("Logic error");
+        }
+        const char *run_end = pos_ + 1;
+        const bool is_literal = c == 'n' || c == 't' || c == 'f';
+        while (run_end != end_ && (is_literal ? detail::IsLiteralChar(*run_end) : detail::IsNumberChar(*run_end)))
+        {
+            ++run_end;
+        }
+        // Пропуск останавливается только на структурных символах, поэтому хвост вроде "1x"
+        // не заметен при переходе к элементу и проверяется здесь, как при обычном разборе
+        if (run_end != end_ && !detail::IsScalarEnd(*run_end))
+        {
+            throw ParsingError("Unexpected symbol");
+        }
+        const std::string_view token(pos_, static_cast<size_t>(run_end - pos_));
+        ScalarBuilder builder;
+        if (is_literal)
+        {
+            detail::EmitLiteral(token, builder);
+        }
+        else
+        {
+            detail::EmitNumber(token, builder);
+        }
+        return move(builder.value);
+    }
+
+    bool LazyNode::IsNull() const
+    {
+        return *pos_ == 'n' && LoadScalar().IsNull();
+    }
+    bool LazyNode::IsBool() const
+    {
+        return (*pos_ == 't' || *pos_ == 'f') && LoadScalar().IsBool();
+    }
+    bool LazyNode::IsInt() const
+    {
+        return detail::IsNumberStart(*pos_) && LoadScalar().IsInt();
+    }
+    bool LazyNode::IsInt64() const
+    {
+        return detail::IsNumberStart(*pos_) && LoadScalar().IsInt64();
+    }
+    bool LazyNode::IsDouble() const
+    {
+        return detail::IsNumberStart(*pos_) && LoadScalar().IsDouble();
+    }
+    bool LazyNode::IsPureDouble() const
+    {
+        return detail::IsNumberStart(*pos_) && LoadScalar().IsPureDouble();
+    }
+    bool LazyNode::IsString() const
+    {
+        return *pos_ == '"';
+    }
+    bool LazyNode::IsArray() const
+    {
+        return *pos_ == '[';
+    }
+    bool LazyNode::IsMap() const
+    {
+        return *pos_ == '{';
+    }
+
+    bool LazyNode::AsBool() const
+    {
+        return LoadScalar().AsBool();
+    }
+    int LazyNode::AsInt() const
+    {
+        return LoadScalar().AsInt();
+    }
+    int64_t LazyNode::AsInt64() const
+    {
+        return LoadScalar().AsInt64();
+    }
+    double LazyNode::AsDouble() const
+    {
+        return LoadScalar().AsDouble();
+    }
+    std::string LazyNode::AsString() const
+    {
+        if (IsString())
+            return DecodeString(pos_ + 1, end_);
+        throw std::logic_error("Logic error");
+    }
+    LazyArray LazyNode::AsArray() const
+    {
+        if (IsArray())
+            return LazyArray(pos_ + 1, end_);
+        throw std::logic_error("Logic error");
+    }
+    LazyObject LazyNode::AsMap() const
+    {
+        if (IsMap())
+            return LazyObject(pos_ + 1, end_);
+        throw std::logic_error("Logic error");
+    }
+
+    LazyNode LazyNode::operator[](std::string_view key) const
+    {
+        return AsMap().at(key);
+    }
+
+    LazyNode LazyNode::operator[](size_t index) const
+    {
+        return AsArray().at(index);
+    }
+
+    std::string_view LazyNode::GetText() const
+    {
+        return {pos_, static_cast<size_t>(detail::SkipValue(pos_, end_) - pos_)};
+    }
+
+    Document LazyNode::Materialize() const
+    {
+        return Load(GetText());
+    }
+
+    LazyArray::const_iterator::const_iterator(const char *pos, const char *end)
+        : end_(end)
+    {
+        Settle(pos, true);
+    }
+
+    void LazyArray::const_iterator::Settle(const char *pos, bool first)
+    {
+        pos_ = SkipSeparator(pos, end_, ']', first, "Expected ']'");
+        if (pos_ != nullptr)
+        {
+            node_ = LazyNode(CheckValueStart(pos_, end_, "Expected ']'"), end_);
+        }
+    }
+
+    LazyArray::const_iterator::reference LazyArray::const_iterator::operator*() const
+    {
+        return node_;
+    }
+
+    LazyArray::const_iterator::pointer LazyArray::const_iterator::operator->() const
+    {
+        return &node_;
+    }
+
+    LazyArray::const_iterator &LazyArray::const_iterator::operator++()
+    {
+        const std::string_view text = node_.GetText();
+        Settle(text.data() + text.size(), false);
+        return *this;
+    }
+
+    LazyArray::const_iterator LazyArray::const_iterator::operator++(int)
+    {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool LazyArray::const_iterator::operator==(const const_iterator &rhs) const
+    {
+        return pos_ == rhs.pos_;
+    }
+
+    bool LazyArray::const_iterator::operator!=(const const_iterator &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    LazyArray::LazyArray(const char *pos, const char *end)
+        : pos_(pos), end_(end) {}
+
+    LazyArray::const_iterator LazyArray::begin() const
+    {
+        return const_iterator(pos_, end_);
+    }
+
+    LazyArray::const_iterator LazyArray::end() const
+    {
+        return {};
+    }
+
+    size_t LazyArray::size() const
+    {
+        return static_cast<size_t>(std::distance(begin(), end()));
+    }
+
+    bool LazyArray::empty() const
+    {
+        return begin() == end();
+    }
+
+    LazyNode LazyArray::at(size_t index) const
+    {
+        for (auto it = begin(); it != end(); ++it, --index)
+        {
+            if (index == 0)
+            {
+                return *it;
+            }
+        }
+        throw std::out_of_range("Array index is out of range");
+    }
+
+    LazyObject::const_iterator::const_iterator(const char *pos, const char *end)
+        : end_(end)
+    {
+        Settle(pos, true);
+    }
+
+    void LazyObject::const_iterator::Settle(const char *pos, bool first)
+    {
+        pos_ = SkipSeparator(pos, end_, '}', first, "Expected '}'");
+        if (pos_ == nullptr)
+        {
+            return;
+        }
+        if (*pos_ != '"')
+        {
+            throw ParsingError("String parsing error");
+        }
+        const char *key_end = detail::SkipString(pos_ + 1, end_);
+        pair_.first = {pos_ + 1, static_cast<size_t>(key_end - 1 - (pos_ + 1))};
+        pos_ = detail::SkipSpace(key_end, end_);
+        if (pos_ == end_ || *pos_ != ':')
+        {
+            throw ParsingError("Expected ':'");
+        }
+        pos_ = CheckValueStart(detail::SkipSpace(pos_ + 1, end_), end_, "Expected '}'");
+        pair_.second = LazyNode(pos_, end_);
+    }
+
+    LazyObject::const_iterator::reference LazyObject::const_iterator::operator*() const
+    {
+        return pair_;
+    }
+
+    LazyObject::const_iterator::pointer LazyObject::const_iterator::operator->() const
+    {
+        return &pair_;
+    }
+
+    LazyObject::const_iterator &LazyObject::const_iterator::operator++()
+    {
+        const std::string_view text = pair_.second.GetText();
+        Settle(text.data() + text.size(), false);
+        return *this;
+    }
+
+    LazyObject::const_iterator LazyObject::const_iterator::operator++(int)
+    {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool LazyObject::const_iterator::operator==(const const_iterator &rhs) const
+    {
+        return pos_ == rhs.pos_;
+    }
+
+    bool LazyObject::const_iterator::operator!=(const const_iterator &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    LazyObject::LazyObject(const char *pos, const char *end)
+        : pos_(pos), end_(end) {}
+
+    LazyObject::const_iterator LazyObject::begin() const
+    {
+        return const_iterator(pos_, end_);
+    }
+
+    LazyObject::const_iterator LazyObject::end() const
+    {
+        return {};
+    }
+
+    size_t LazyObject::size() const
+    {
+        return static_cast<size_t>(std::distance(begin(), end()));
+    }
+
+    bool LazyObject::empty() const
+    {
+        return begin() == end();
+    }
+
+    LazyObject::const_iterator LazyObject::find(std::string_view key) const
+    {
+        for (auto it = begin(); it != end(); ++it)
+        {
+            const std::string_view raw = it->first;
+            // Ключ с escape-последовательностями приходится раскодировать перед сравнением
+            if (raw.find('\\') == std::string_view::npos ? raw == key : DecodeString(raw.data(), end_) == key)
+            {
+                return it;
+            }
+        }
+        return end();
+    }
+
+    size_t LazyObject::count(std::string_view key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    LazyNode LazyObject::at(std::string_view key) const
+    {
+        const auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("Key is not found");
+        }
+        return it->second;
+    }
+
+    LazyDocument::LazyDocument(std::string_view text)
+        : text_(text) {}
+
+    LazyDocument::LazyDocument(std::string_view text, std::shared_ptr<const void> storage)
+        : storage_(move(storage)), text_(text) {}
+
+    LazyNode LazyDocument::GetRoot() const
+    {
+        const char *end = text_.data() + text_.size();
+        const char *pos = detail::SkipSpace(text_.data(), end);
+        return LazyNode(CheckValueStart(pos, end, "Unexpected end of input"), end);
+    }
+
+    LazyDocument LoadLazy(std::string_view text)
+    {
+        return LazyDocument(text);
+    }
+
+    LazyDocument LoadLazyFile(const std::string &path)
+    {
+        auto file = std::make_shared<MappedFile>(path);
+        const std::string_view data = file->GetData();
+        return LazyDocument(data, move(file));
+    }
+
+} // namespace json
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace json
+{
+    class LazyArray;
+    class LazyObject;
+
+    // Узел ленивого документа - курсор на начало значения во входном тексте.
+    // Ничего не разбирается заранее: каждое обращение читает ровно столько текста, сколько
+    // нужно, а ненужные значения пропускаются без разбора. Поэтому ошибки в тексте
+    // обнаруживаются только при обращении к испорченной части.
+    // Курсор действителен, пока жив LazyDocument, из которого он получен
+    class LazyNode
+    {
+    public:
+        // pos указывает на первый символ значения, end - на конец всего текста
+        LazyNode(const char *pos, const char *end);
+
+        bool IsNull() const;
+        bool IsBool() const;
+        bool IsInt() const;
+        bool IsInt64() const;
+        bool IsDouble() const;
+        bool IsPureDouble() const;
+        bool IsString() const;
+        bool IsArray() const;
+        bool IsMap() const;
+
+        bool AsBool() const;
+        int AsInt() const;
+        int64_t AsInt64() const;
+        double AsDouble() const;
+        // Строка с раскодированными escape-последовательностями
+        std::string AsString() const;
+        LazyArray AsArray() const;
+        LazyObject AsMap() const;
+
+        // Значение по ключу словаря или по номеру элемента массива.
+        // Бросают std::out_of_range, если такого значения нет
+        LazyNode operator[](std::string_view key) const;
+        LazyNode operator[](size_t index) const;
+
+        // Исходный текст значения
+        std::string_view GetText() const;
+        // Полностью разбирает значение в обычный документ
+        Document Materialize() const;
+
+    private:
+        // Разбирает число, литерал или строку
+        Node LoadScalar() const;
+
+        const char *pos_;
+        const char *end_;
+    };
+
+    // Массив, элементы которого перебираются по мере продвижения по тексту
+    class LazyArray
+    {
+    public:
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = LazyNode;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const LazyNode *;
+            using reference = const LazyNode &;
+
+            const_iterator() = default;
+            const_iterator(const char *pos, const char *end);
+
+            reference operator*() const;
+            pointer operator->() const;
+            const_iterator &operator++();
+            const_iterator operator++(int);
+            bool operator==(const const_iterator &rhs) const;
+            bool operator!=(const const_iterator &rhs) const;
+
+        private:
+            // Ставит курсор на значение, начиная с pos, или в конец, если массив закончился.
+            // first - pos стоит сразу за открывающей скобкой
+            void Settle(const char *pos, bool first);
+
+            LazyNode node_{nullptr, nullptr};
+            // Начало текущего значения, nullptr в конце массива
+            const char *pos_ = nullptr;
+            const char *end_ = nullptr;
+        };
+
+        // pos стоит сразу за '['
+        LazyArray(const char *pos, const char *end);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        // Обходит массив целиком
+        size_t size() const;
+        bool empty() const;
+        LazyNode at(size_t index) const;
+
+    private:
+        const char *pos_;
+        const char *end_;
+    };
+
+    // Словарь, пары которого перебираются в порядке следования в тексте.
+    // Ключ в паре - исходный текст между кавычками, escape-последовательности в нём не раскодированы.
+    // Поиск сравнивает раскодированные ключи и, как Dict, при повторах находит первый
+    class LazyObject
+    {
+    public:
+        using value_type = std::pair<std::string_view, LazyNode>;
+
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = LazyObject::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+
+            const_iterator() = default;
+            const_iterator(const char *pos, const char *end);
+
+            reference operator*() const;
+            pointer operator->() const;
+            const_iterator &operator++();
+            const_iterator operator++(int);
+            bool operator==(const const_iterator &rhs) const;
+            bool operator!=(const const_iterator &rhs) const;
+
+        private:
+            void Settle(const char *pos, bool first);
+
+            value_type pair_{std::string_view{}, LazyNode{nullptr, nullptr}};
+            // Начало текущего значения, nullptr в конце словаря
+            const char *pos_ = nullptr;
+            const char *end_ = nullptr;
+        };
+
+        // pos стоит сразу за '{'
+        LazyObject(const char *pos, const char *end);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        LazyNode at(std::string_view key) const;
+
+    private:
+        const char *pos_;
+        const char *end_;
+    };
+
+    // Текст, разбираемый по требованию. Сам документ ничего не разбирает
+    class LazyDocument
+    {
+    public:
+        // Текст не копируется и должен жить дольше документа
+        explicit LazyDocument(std::string_view text);
+        // storage владеет памятью, в которой лежит текст
+        LazyDocument(std::string_view text, std::shared_ptr<const void> storage);
+
+        // Бросает ParsingError, если текст пустой
+        LazyNode GetRoot() const;
+
+    private:
+        std::shared_ptr<const void> storage_;
+        std::string_view text_;
+    };
+
+    LazyDocument LoadLazy(std::string_view text);
+    // Файл отображается в память и остаётся в ней, пока жив документ
+    LazyDocument LoadLazyFile(const std::string &path);
+
+} // namespace json
@@ -0,0 +1,141 @@
+#include "json_lines.h"
+#include "json_parser.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Кусок должен быть достаточно большим, чтобы запуск задачи был незаметен на фоне разбора,
+        // и достаточно маленьким, чтобы потоки загружались равномерно
+        constexpr size_t kMinChunkSize = 64 * 1024;
+        constexpr size_t kMaxChunkSize = 4 * 1024 * 1024;
+        // Сколько кусков на поток разбирается за один проход
+        constexpr size_t kChunksPerThread = 4;
+
+        // Результат разбора одного куска
+        struct Chunk
+        {
+            std::string_view text;
+            std::vector<Document> documents;
+            // Строк в куске, включая пустые
+            size_t lines = 0;
+            // Ошибка и номер строки внутри куска, на которой она случилась
+            std::string error;
+            size_t error_line = 0;
+        };
+
+        // Конец строки, начинающейся в pos, вместе с символом перевода строки
+        const char *FindLineEnd(const char *pos, const char *end)
+        {
+            const void *newline = std::memchr(pos, '\n', static_cast<size_t>(end - pos));
+            return newline == nullptr ? end : static_cast<const char *>(newline) + 1;
+        }
+
+        void LoadChunk(Chunk &chunk, const LoadOptions &options, const std::shared_ptr<const void> &input_storage)
+        {
+            const char *pos = chunk.text.data();
+            const char *end = pos + chunk.text.size();
+            while (pos != end)
+            {
+                const char *line_end = FindLineEnd(pos, end);
+                const std::string_view line(pos, static_cast<size_t>(line_end - pos));
+                pos = line_end;
+                ++chunk.lines;
+                if (detail::SkipSpace(line.data(), line_end) == line_end)
+                {
+                    continue;
+                }
+                try
+                {
+                    // Вторая запись на той же строке или мусор после записи - ошибка строки
+                    chunk.documents.push_back(detail::LoadDocument(line, options, input_storage, true));
+                }
+                catch (const ParsingError &e)
+                {
+                    // Следующие строки этого куска уже не понадобятся
+                    chunk.error = e.what();
+                    chunk.error_line = chunk.lines - 1;
+                    return;
+                }
+            }
+        }
+
+        void LoadLinesImpl(std::string_view input, const RecordCallback &callback, const LoadOptions &load_options, size_t threads,
+                           const std::shared_ptr<const void> &input_storage)
+        {
+            // Строки разбираются на нескольких потоках, и один ParseStats на всех был бы гонкой
+            LoadOptions options = load_options;
+            options.stats = nullptr;
+            if (threads == 0)
+            {
+                threads = detail::GetDefaultThreadCount();
+            }
+            const size_t chunk_size = std::clamp(input.size() / (threads * kChunksPerThread), kMinChunkSize, kMaxChunkSize);
+            const char *pos = input.data();
+            const char *end = input.data() + input.size();
+            size_t line_base = 0;
+            std::vector<Chunk> chunks;
+            while (pos != end)
+            {
+                // Нарезаем очередную порцию кусков по границам строк. Строка внутри JSON не может
+                // содержать перевод строки, поэтому граница строки всегда разделяет записи
+                chunks.clear();
+                while (pos != end && chunks.size() < threads * kChunksPerThread)
+                {
+                    const char *chunk_end = static_cast<size_t>(end - pos) <= chunk_size ? end : FindLineEnd(pos + chunk_size - 1, end);
+                    chunks.push_back({std::string_view(pos, static_cast<size_t>(chunk_end - pos)), {}, 0, {}, 0});
+                    pos = chunk_end;
+                }
+                detail::ParallelFor(chunks.size(), threads, [&](size_t i)
+                                    { LoadChunk(chunks[i], options, input_storage); });
+                for (Chunk &chunk : chunks)
+                {
+                    for (Document &document : chunk.documents)
+                    {
+                        callback(move(document));
+                    }
+                    if (!chunk.error.empty())
+                    {
+                        throw ParsingError("Line "s + std::to_string(line_base + chunk.error_line + 1) + ": "s + chunk.error);
+                    }
+                    line_base += chunk.lines;
+                }
+            }
+        }
+
+        std::vector<Document> CollectLines(std::string_view input, const LoadOptions &options, size_t threads,
+                                           const std::shared_ptr<const void> &input_storage)
+        {
+            std::vector<Document> documents;
+            LoadLinesImpl(input, [&documents](Document document)
+                          { documents.push_back(move(document)); }, options, threads, input_storage);
+            return documents;
+        }
+
+    } // namespace
+
+    std::vector<Document> LoadLines(std::string_view input, const LoadOptions &options, size_t threads)
+    {
+        return CollectLines(input, options, threads, nullptr);
+    }
+
+    void LoadLines(std::string_view input, const RecordCallback &callback, const LoadOptions &options, size_t threads)
+    {
+        LoadLinesImpl(input, callback, options, threads, nullptr);
+    }
+
+    std::vector<Document> LoadLinesFile(const std::string &path, const LoadOptions &options, size_t threads)
+    {
+        auto file = std::make_shared<MappedFile>(path);
+        return CollectLines(file->GetData(), options, threads, file);
+    }
+
+} // namespace json
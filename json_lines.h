@@ -0,0 +1,28 @@
+#pragma once
+
+#include "json.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+    // Получает документы JSON Lines по одному, в порядке следования во входе
+    using RecordCallback = std::function<void(Document)>;
+
+    // Разбирает JSON Lines (NDJSON): по одному значению на строке, пустые строки пропускаются.
+    // После значения на той же строке допускаются только пробелы.
+    // Вход режется на куски по границам строк, и куски разбираются параллельно на threads
+    // потоках (0 - по числу ядер). Документы возвращаются в порядке строк. При ошибке бросается
+    // ParsingError с номером первой строки, которую не удалось разобрать.
+    // При options.borrow_strings вход должен пережить документы
+    std::vector<Document> LoadLines(std::string_view input, const LoadOptions &options = {}, size_t threads = 0);
+    // То же, но документы отдаются callback в вызывающем потоке по мере готовности, так что
+    // в памяти одновременно находится лишь несколько кусков входа
+    void LoadLines(std::string_view input, const RecordCallback &callback, const LoadOptions &options = {}, size_t threads = 0);
+    // Отображает файл в память. При borrow_strings отображение живёт, пока жив хотя бы один документ
+    std::vector<Document> LoadLinesFile(const std::string &path, const LoadOptions &options = {}, size_t threads = 0);
+
+} // namespace json
@@ -0,0 +1,1097 @@
+#pragma once
+
+// Внутренняя часть библиотеки: грамматика JSON, общая для всех способов разбора.
+// Парсеры отсюда не строят узлы сами, а сообщают о найденных значениях обработчику
+// с методами OnNull/OnBool/OnInt/OnDouble/OnString/OnKey/OnStartArray/OnEndArray/
+// OnStartObject/OnEndObject. Обработчик подставляется шаблонным параметром, поэтому
+// для внутреннего построителя документа вызовы не виртуальные
+
+#include "json.h"
+
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_PARSER_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace json
+{
+    namespace detail
+    {
+        inline bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+
+        // Символы, которые продолжают литерал null/true/false.
+        // Литерал, за которым идёт такой символ, считается ошибкой
+        inline bool IsLiteralChar(char c)
+        {
+            const auto code = static_cast<unsigned char>(c);
+            return (code > 45 && code < 92) || (code > 93 && code < 125);
+        }
+
+        // Символы, которыми может продолжаться текст сразу за числом или литералом
+        inline bool IsScalarEnd(char c)
+        {
+            return IsSpace(c) || c == ',' || c == ']' || c == '}' || c == ':' || c == '"' || c == '[' || c == '{';
+        }
+
+        inline bool IsNumberStart(char c)
+        {
+            return (c > 47 && c < 58) || c == '.' || c == '+' || c == '-';
+        }
+
+        inline bool IsNumberChar(char c)
+        {
+            return (c >= '0' && c <= '9') || c == '.' || c == '+' || c == '-' || c == 'e' || c == 'E';
+        }
+
+#ifdef JSON_PARSER_SSE2
+        inline int CountTrailingZeros(unsigned mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+#endif
+
+        // Первый символ из [pos, end), на котором простое копирование строки прерывается:
+        // кавычка, обратная косая черта или перевод строки. Обычная строка проверяется по 16 байт
+        inline const char *FindStringSpecial(const char *pos, const char *end)
+        {
+#ifdef JSON_PARSER_SSE2
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i newline = _mm_set1_epi8('\n');
+            const __m128i carriage_return = _mm_set1_epi8('\r');
+            while (end - pos >= 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+                const __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage_return)));
+                const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+                if (mask != 0)
+                {
+                    return pos + CountTrailingZeros(mask);
+                }
+                pos += 16;
+            }
+#endif
+            while (pos != end && *pos != '"' && *pos != '\\' && *pos != '\n' && *pos != '\r')
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // Escape-последовательность, которую мог оборвать конец куска. Хранит уже прочитанные
+        // символы, начиная с обратной косой черты; size == 0 - последовательности нет.
+        // Самая длинная - суррогатная пара из двух последовательностей \\u, 12 символов
+        struct StringEscape
+        {
+            char text[12];
+            uint8_t size = 0;
+        };
+
+        inline int HexDigit(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            return -1;
+        }
+
+        // Четыре шестнадцатеричные цифры после \u
+        inline uint32_t ParseHex4(const char *digits)
+        {
+            uint32_t code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const int digit = HexDigit(digits[i]);
+                if (digit < 0)
+                {
+                    throw ParsingError("Invalid \\u escape sequence");
+                }
+                code = code * 16 + static_cast<uint32_t>(digit);
+            }
+            return code;
+        }
+
+        inline bool IsHighSurrogate(uint32_t code)
+        {
+            return code >= 0xD800 && code <= 0xDBFF;
+        }
+
+        inline bool IsLowSurrogate(uint32_t code)
+        {
+            return code >= 0xDC00 && code <= 0xDFFF;
+        }
+
+        // Полная длина последовательности, которая начинается с уже прочитанных символов
+        inline size_t GetEscapeLength(const StringEscape &escape)
+        {
+            if (escape.size < 2 || escape.text[1] != 'u')
+            {
+                return 2;
+            }
+            if (escape.size < 6)
+            {
+                return 6;
+            }
+            return IsHighSurrogate(ParseHex4(escape.text + 2)) ? 12 : 6;
+        }
+
+        inline void AppendUtf8(uint32_t code, std::string &buffer)
+        {
+            if (code < 0x80)
+            {
+                buffer.push_back(static_cast<char>(code));
+            }
+            else if (code < 0x800)
+            {
+                buffer.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                buffer.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else if (code < 0x10000)
+            {
+                buffer.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                buffer.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                buffer.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else
+            {
+                buffer.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                buffer.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                buffer.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                buffer.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+
+        // Раскодирует полную последовательность. \uXXXX записывается в UTF-8,
+        // символы вне базовой плоскости приходят суррогатной парой
+        inline void DecodeEscape(const StringEscape &escape, std::string &buffer)
+        {
+            using namespace std::literals;
+
+            const char escaped_char = escape.text[1];
+            switch (escaped_char)
+            {
+            case 'n':
+                buffer.push_back('\n');
+                break;
+            case 't':
+                buffer.push_back('\t');
+                break;
+            case 'r':
+                buffer.push_back('\r');
+                break;
+            case 'b':
+                buffer.push_back('\b');
+                break;
+            case 'f':
+                buffer.push_back('\f');
+                break;
+            case '"':
+                buffer.push_back('"');
+                break;
+            case '\\':
+                buffer.push_back('\\');
+                break;
+            case '/':
+                buffer.push_back('/');
+                break;
+            case 'u':
+            {
+                uint32_t code = ParseHex4(escape.text + 2);
+                if (IsHighSurrogate(code))
+                {
+                    if (escape.text[6] != '\\' || escape.text[7] != 'u')
+                    {
+                        throw ParsingError("Invalid surrogate pair");
+                    }
+                    const uint32_t low = ParseHex4(escape.text + 8);
+                    if (!IsLowSurrogate(low))
+                    {
+                        throw ParsingError("Invalid surrogate pair");
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (IsLowSurrogate(code))
+                {
+                    throw ParsingError("Invalid surrogate pair");
+                }
+                AppendUtf8(code, buffer);
+                break;
+            }
+            default:
+                // Встретили неизвестную escape-последовательность
+                throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+            }
+        }
+
+        // Раскодирует очередную часть строки в buffer. escape хранит последовательность,
+        // которую оборвал конец предыдущей части. Возвращает true, если встретилась
+        // закрывающая кавычка, и тогда pos указывает на символ за ней
+        inline bool DecodeString(const char *&pos, const char *end, std::string &buffer, StringEscape &escape)
+        {
+            using namespace std::literals;
+
+            while (pos != end)
+            {
+                if (escape.size != 0)
+                {
+                    // Последовательность дочитывается посимвольно: её длина известна не сразу
+                    size_t length = GetEscapeLength(escape);
+                    while (escape.size < length && pos != end)
+                    {
+                        escape.text[escape.size++] = *pos++;
+                        length = GetEscapeLength(escape);
+                    }
+                    if (escape.size < length)
+                    {
+                        break;
+                    }
+                    DecodeEscape(escape, buffer);
+                    escape.size = 0;
+                    continue;
+                }
+                // Символы до ближайшего особого копируются разом
+                const char *special = FindStringSpecial(pos, end);
+                buffer.append(pos, special);
+                pos = special;
+                if (pos == end)
+                {
+                    break;
+                }
+                const char ch = *pos++;
+                if (ch == '"')
+                {
+                    // Встретили закрывающую кавычку
+                    return true;
+                }
+                if (ch == '\\')
+                {
+                    // Встретили начало escape-последовательности
+                    escape.text[0] = ch;
+                    escape.size = 1;
+                    continue;
+                }
+                // Строковый литерал внутри JSON не может прерываться символами \r или \n
+                throw ParsingError("Unexpected end of line"s);
+            }
+            return false;
+        }
+
+        // Одиночный пробел между токенами отсекается первым же сравнением, а длинные
+        // отступы красиво оформленного текста проверяются по 16 байт
+        inline const char *SkipSpace(const char *pos, const char *end)
+        {
+#ifdef JSON_PARSER_SSE2
+            // \t, \n, \v, \f и \r - коды с 9 по 13
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i below_tab = _mm_set1_epi8(8);
+            const __m128i above_return = _mm_set1_epi8(14);
+            while (end - pos >= 16 && IsSpace(*pos))
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+                const __m128i is_space = _mm_or_si128(
+                    _mm_cmpeq_epi8(chunk, space),
+                    _mm_and_si128(_mm_cmpgt_epi8(chunk, below_tab), _mm_cmplt_epi8(chunk, above_return)));
+                const unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(is_space)) & 0xFFFFu;
+                if (other != 0)
+                {
+                    return pos + CountTrailingZeros(other);
+                }
+                pos += 16;
+            }
+#endif
+            while (pos != end && IsSpace(*pos))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // pos стоит сразу за открывающей кавычкой. Возвращает позицию за закрывающей кавычкой.
+        // Содержимое строки не проверяется, ищется только кавычка без экранирования
+        inline const char *SkipString(const char *pos, const char *end)
+        {
+            const char *begin = pos;
+            while (true)
+            {
+                const void *found = std::memchr(pos, '"', static_cast<size_t>(end - pos));
+                if (found == nullptr)
+                {
+                    throw ParsingError("String parsing error");
+                }
+                const char *quote = static_cast<const char *>(found);
+                // Кавычка экранирована, если перед ней нечётное число обратных косых черт
+                const char *slash = quote;
+                while (slash != begin && slash[-1] == '\\')
+                {
+                    --slash;
+                }
+                pos = quote + 1;
+                if ((quote - slash) % 2 == 0)
+                {
+                    return pos;
+                }
+            }
+        }
+
+        // Пропускает значение, которое начинается в pos, и возвращает позицию за ним.
+        // Внутри массивов и словарей проверяется только парность скобок и закрытость строк,
+        // поэтому пропуск обходится намного дешевле разбора
+        inline const char *SkipValue(const char *pos, const char *end)
+        {
+            const char c = *pos;
+            if (c == '"')
+            {
+                return SkipString(pos + 1, end);
+            }
+            if (c != '[' && c != '{')
+            {
+                while (pos != end && !IsSpace(*pos) && *pos != ',' && *pos != ']' && *pos != '}' && *pos != ':')
+                {
+                    ++pos;
+                }
+                return pos;
+            }
+            size_t depth = 0;
+            while (pos != end)
+            {
+                switch (*pos++)
+                {
+                case '"':
+                    pos = SkipString(pos, end);
+                    break;
+                case '[':
+                case '{':
+                    ++depth;
+                    break;
+                case ']':
+                case '}':
+                    if (--depth == 0)
+                    {
+                        return pos;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            throw ParsingError(c == '[' ? "Expected ']'" : "Expected '}'");
+        }
+
+        // Проверяет литерал целиком, вместе со всеми символами, которые его продолжают.
+        // Возвращает текст ошибки или nullptr
+        inline const char *CheckLiteral(std::string_view token)
+        {
+            using namespace std::literals;
+
+            const auto check = [token](std::string_view literal, const char *mismatch, const char *redundant) -> const char *
+            {
+                if (token.substr(0, literal.size()) != literal)
+                {
+                    return mismatch;
+                }
+                return token.size() > literal.size() ? redundant : nullptr;
+            };
+            if (token[0] == 'n')
+            {
+                return check("null"sv, "Similiar to null value", "Redundant symbols after null");
+            }
+            if (token[0] == 't')
+            {
+                return check("true"sv, "Similiar to boolean value", "Redundant symbols after true");
+            }
+            return check("false"sv, "Similiar to boolean value", "Redundant symbols after false");
+        }
+
+        template <typename Handler>
+        void EmitLiteral(std::string_view token, Handler &handler)
+        {
+            if (const char *error = CheckLiteral(token))
+            {
+                throw ParsingError(error);
+            }
+            if (token[0] == 'n')
+            {
+                handler.OnNull();
+            }
+            else
+            {
+                handler.OnBool(token[0] == 't');
+            }
+        }
+
+        inline constexpr char kDigitExpected[] = "A digit is expected";
+
+        // Проверяет запись числа по грамматике JSON, не переводя его. Возвращает текст ошибки
+        // или nullptr; is_int - у числа нет ни дробной части, ни экспоненты
+        inline const char *CheckNumber(std::string_view token, bool &is_int)
+        {
+            size_t pos = 0;
+            const auto read_digits = [&]
+            {
+                if (pos == token.size() || token[pos] < '0' || token[pos] > '9')
+                {
+                    return false;
+                }
+                while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9')
+                {
+                    ++pos;
+                }
+                return true;
+            };
+
+            if (pos < token.size() && token[pos] == '-')
+            {
+                ++pos;
+            }
+            // Парсим целую часть числа; после 0 в JSON не могут идти другие цифры
+            if (pos < token.size() && token[pos] == '0')
+            {
+                ++pos;
+            }
+            else if (!read_digits())
+            {
+                return kDigitExpected;
+            }
+
+            is_int = true;
+            // Парсим дробную часть числа
+            if (pos < token.size() && token[pos] == '.')
+            {
+                ++pos;
+                if (!read_digits())
+                {
+                    return kDigitExpected;
+                }
+                is_int = false;
+            }
+
+            // Парсим экспоненциальную часть числа
+            if (pos < token.size() && (token[pos] == 'e' || token[pos] == 'E'))
+            {
+                ++pos;
+                if (pos < token.size() && (token[pos] == '+' || token[pos] == '-'))
+                {
+                    ++pos;
+                }
+                if (!read_digits())
+                {
+                    return kDigitExpected;
+                }
+                is_int = false;
+            }
+            return pos == token.size() ? nullptr : "Failed to convert number";
+        }
+
+        // Проверяет число по грамматике JSON и переводит его через std::from_chars:
+        // без выделений памяти, исключений на переполнении и зависимости от локали
+        template <typename Handler>
+        void EmitNumber(std::string_view token, Handler &handler)
+        {
+            using namespace std::literals;
+
+            bool is_int = true;
+            const char *error = CheckNumber(token, is_int);
+            if (error == kDigitExpected)
+            {
+                throw ParsingError(error);
+            }
+            const char *begin = token.data();
+            const char *end = token.data() + token.size();
+            if (error == nullptr)
+            {
+                if (is_int)
+                {
+                    int64_t value;
+                    const auto [ptr, ec] = std::from_chars(begin, end, value);
+                    if (ec == std::errc{} && ptr == end)
+                    {
+                        handler.OnInt(value);
+                        return;
+                    }
+                    // При переполнении int64_t число читается как double
+                }
+                double value;
+                const auto [ptr, ec] = std::from_chars(begin, end, value);
+                if (ec == std::errc{} && ptr == end)
+                {
+                    handler.OnDouble(value);
+                    return;
+                }
+            }
+            throw ParsingError("Failed to convert "s + std::string(token) + " to number"s);
+        }
+
+        // depth - сколько контейнеров уже открыто
+        inline void CheckDepth(size_t depth, size_t max_depth)
+        {
+            if (max_depth != 0 && depth >= max_depth)
+            {
+                throw ParsingError("Maximum nesting depth exceeded");
+            }
+        }
+
+        // Потоковый разбор с явным стеком вложенности вместо рекурсии. Данные можно подавать
+        // кусками произвольного размера: токен, оборванный на границе куска, дочитывается
+        // из следующего, а уже разобранное повторно не просматривается.
+        // Пока значение не выходит за границы куска, строки без escape-последовательностей
+        // передаются обработчику как string_view прямо на входные данные
+        template <typename Handler>
+        class EventParser
+        {
+        public:
+            // max_depth - наибольшая вложенность контейнеров, 0 - без ограничения
+            explicit EventParser(Handler &handler, size_t max_depth = 0)
+                : handler_(handler), max_depth_(max_depth) {}
+
+            // Возвращает, сколько байт куска разобрано: меньше размера куска, только если
+            // корневое значение закончилось раньше него
+            size_t Feed(std::string_view chunk)
+            {
+                const char *pos = chunk.data();
+                const char *end = chunk.data() + chunk.size();
+                if (token_ != Token::None && !ContinueToken(pos, end))
+                {
+                    return chunk.size();
+                }
+                while (pos != end && state_ != State::Done)
+                {
+                    const char c = *pos;
+                    if (IsSpace(c))
+                    {
+                        ++pos;
+                        continue;
+                    }
+                    switch (state_)
+                    {
+                    case State::ArrayStart:
+                    case State::ArrayNext:
+                        if (c == ']')
+                        {
+                            ++pos;
+                            stack_.pop_back();
+                            handler_.OnEndArray();
+                            ValueDone();
+                            continue;
+                        }
+                        // Элементы разделяются ровно одной запятой: перед первым элементом
+                        // и после последнего её быть не может
+                        if (state_ == State::ArrayStart)
+                        {
+                            break;
+                        }
+                        if (c != ',')
+                        {
+                            throw ParsingError("Expected ',' or ']'");
+                        }
+                        ++pos;
+                        state_ = State::Value;
+                        continue;
+                    case State::ObjectStart:
+                    case State::ObjectNext:
+                        if (c == '}')
+                        {
+                            ++pos;
+                            stack_.pop_back();
+                            handler_.OnEndObject();
+                            ValueDone();
+                            continue;
+                        }
+                        if (state_ == State::ObjectNext)
+                        {
+                            if (c != ',')
+                            {
+                                throw ParsingError("Expected ',' or '}'");
+                            }
+                            ++pos;
+                            state_ = State::ObjectKey;
+                            continue;
+                        }
+                        [[fallthrough]];
+                    case State::ObjectKey:
+                        if (c != '"')
+                        {
+                            throw ParsingError("String parsing error");
+                        }
+                        ++pos;
+                        if (!StartString(pos, end, Token::Key))
+                        {
+                            return chunk.size();
+                        }
+                        continue;
+                    case State::ObjectColon:
+                        if (c != ':')
+                        {
+                            throw ParsingError("Expected ':'");
+                        }
+                        ++pos;
+                        state_ = State::Value;
+                        continue;
+                    default:
+                        break;
+                    }
+                    if (!StartValue(pos, end))
+                    {
+                        return chunk.size();
+                    }
+                }
+                return static_cast<size_t>(pos - chunk.data());
+            }
+
+            // Сообщает, что данных больше не будет
+            void Finish()
+            {
+                if (token_ == Token::Number || token_ == Token::Literal)
+                {
+                    EmitToken(buffer_);
+                }
+                else if (token_ != Token::None)
+                {
+                    // Поток закончился до того, как встретили закрывающую кавычку
+                    throw ParsingError("String parsing error");
+                }
+                if (state_ == State::Done)
+                {
+                    return;
+                }
+                if (stack_.empty())
+                {
+                    throw ParsingError("Unexpected end of input");
+                }
+                throw ParsingError(stack_.back() ? "Expected ']'" : "Expected '}'");
+            }
+
+            // Корневое значение разобрано целиком; всё, что идёт после него, пропускается
+            bool IsDone() const
+            {
+                return state_ == State::Done;
+            }
+
+        private:
+            enum class State : uint8_t
+            {
+                // Ожидается значение
+                Value,
+                // Сразу после '['
+                ArrayStart,
+                // После элемента массива
+                ArrayNext,
+                // Сразу после '{'
+                ObjectStart,
+                // После запятой в словаре
+                ObjectKey,
+                // После ключа
+                ObjectColon,
+                // После значения в словаре
+                ObjectNext,
+                Done,
+            };
+
+            // Токен, оборванный на границе куска
+            enum class Token : uint8_t
+            {
+                None,
+                String,
+                Key,
+                Number,
+                Literal,
+            };
+
+            bool StartValue(const char *&pos, const char *end)
+            {
+                const char c = *pos;
+                if (c == '[')
+                {
+                    ++pos;
+                    CheckDepth(stack_.size(), max_depth_);
+                    handler_.OnStartArray();
+                    stack_.push_back(true);
+                    state_ = State::ArrayStart;
+                    return true;
+                }
+                else if (c == '{')
+                {
+                    ++pos;
+                    CheckDepth(stack_.size(), max_depth_);
+                    handler_.OnStartObject();
+                    stack_.push_back(false);
+                    state_ = State::ObjectStart;
+                    return true;
+                }
+                else if (c == '"')
+                {
+                    ++pos;
+                    return StartString(pos, end, Token::String);
+                }
+                else if (c == 'n' || c == 't' || c == 'f')
+                {
+                    return StartRun(pos, end, Token::Literal);
+                }
+                else if (IsNumberStart(c))
+                {
+                    return StartRun(pos, end, Token::Number);
+                }
+                else
+                {
+                    throw ParsingError("Unexpected symbol");
+                }
+            }
+
+            // pos стоит сразу за открывающей кавычкой
+            bool StartString(const char *&pos, const char *end, Token token)
+            {
+                const char *special = FindStringSpecial(pos, end);
+                if (special != end && *special == '"')
+                {
+                    // Строка без escape-последовательностей целиком в куске: отдаём её без копирования
+                    const std::string_view value(pos, static_cast<size_t>(special - pos));
+                    pos = special + 1;
+                    EmitString(value, token);
+                    return true;
+                }
+                buffer_.assign(pos, special);
+                pos = special;
+                escape_ = {};
+                token_ = token;
+                return ContinueToken(pos, end);
+            }
+
+            // Числа и литералы - непрерывные последовательности символов; первый символ уже проверен
+            bool StartRun(const char *&pos, const char *end, Token token)
+            {
+                const char *begin = pos;
+                pos = FindRunEnd(pos + 1, end, token);
+                if (pos != end)
+                {
+                    EmitToken({begin, static_cast<size_t>(pos - begin)}, token);
+                    return true;
+                }
+                buffer_.assign(begin, end);
+                token_ = token;
+                return false;
+            }
+
+            // Дочитывает оборванный токен. Возвращает false, если кусок закончился раньше токена
+            bool ContinueToken(const char *&pos, const char *end)
+            {
+                if (token_ == Token::String || token_ == Token::Key)
+                {
+                    if (!DecodeString(pos, end, buffer_, escape_))
+                    {
+                        return false;
+                    }
+                    const Token token = token_;
+                    token_ = Token::None;
+                    EmitString(buffer_, token);
+                    return true;
+                }
+                const char *run_end = FindRunEnd(pos, end, token_);
+                buffer_.append(pos, run_end);
+                pos = run_end;
+                if (pos == end)
+                {
+                    return false;
+                }
+                EmitToken(buffer_);
+                return true;
+            }
+
+            const char *FindRunEnd(const char *pos, const char *end, Token token) const
+            {
+                if (token == Token::Number)
+                {
+                    while (pos != end && IsNumberChar(*pos))
+                    {
+                        ++pos;
+                    }
+                }
+                else
+                {
+                    while (pos != end && IsLiteralChar(*pos))
+                    {
+                        ++pos;
+                    }
+                }
+                return pos;
+            }
+
+            void EmitToken(std::string_view value)
+            {
+                const Token token = token_;
+                token_ = Token::None;
+                EmitToken(value, token);
+            }
+
+            void EmitToken(std::string_view value, Token token)
+            {
+                if (token == Token::Number)
+                {
+                    EmitNumber(value, handler_);
+                }
+                else
+                {
+                    EmitLiteral(value, handler_);
+                }
+                ValueDone();
+            }
+
+            void EmitString(std::string_view value, Token token)
+            {
+                if (token == Token::Key)
+                {
+                    handler_.OnKey(value);
+                    state_ = State::ObjectColon;
+                    return;
+                }
+                handler_.OnString(value);
+                ValueDone();
+            }
+
+            void ValueDone()
+            {
+                if (stack_.empty())
+                {
+                    state_ = State::Done;
+                }
+                else
+                {
+                    state_ = stack_.back() ? State::ArrayNext : State::ObjectNext;
+                }
+            }
+
+            Handler &handler_;
+            size_t max_depth_;
+            // true - массив, false - словарь
+            std::vector<bool> stack_;
+            State state_ = State::Value;
+            Token token_ = Token::None;
+            StringEscape escape_;
+            // Начало оборванного токена или уже раскодированная часть строки
+            std::string buffer_;
+        };
+
+        // Второй проход двухфазного разбора. Переходит по позициям из BuildStructuralIndex,
+        // не просматривая пробелы, и сообщает обработчику те же события, что и EventParser,
+        // проверяя токены теми же функциями. Вложенность хранится в явном стеке, а не в рекурсии
+        template <typename Handler>
+        class IndexedParser
+        {
+        public:
+            // max_depth - наибольшая вложенность контейнеров, 0 - без ограничения
+            IndexedParser(std::string_view input, const std::vector<uint32_t> &index, Handler &handler, size_t max_depth = 0)
+                : input_(input), index_(index), handler_(handler), max_depth_(max_depth) {}
+
+            void Parse()
+            {
+                char c;
+                if (!NextToken(c))
+                {
+                    throw ParsingError("Unexpected end of input");
+                }
+                StartValue(c);
+                // Только что открыт контейнер, и элементов в нём ещё нет
+                bool first = c == '[' || c == '{';
+                while (!stack_.empty())
+                {
+                    const bool is_array = stack_.back();
+                    if (!NextToken(c))
+                    {
+                        break;
+                    }
+                    if (c == (is_array ? ']' : '}'))
+                    {
+                        first = false;
+                        stack_.pop_back();
+                        if (is_array)
+                        {
+                            handler_.OnEndArray();
+                        }
+                        else
+                        {
+                            handler_.OnEndObject();
+                        }
+                        continue;
+                    }
+                    // Как и в EventParser, элементы разделяются ровно одной запятой
+                    if (!first)
+                    {
+                        if (c != ',')
+                        {
+                            throw ParsingError(is_array ? "Expected ',' or ']'" : "Expected ',' or '}'");
+                        }
+                        if (!NextToken(c))
+                        {
+                            break;
+                        }
+                    }
+                    if (!is_array)
+                    {
+                        if (c != '"')
+                        {
+                            throw ParsingError("String parsing error");
+                        }
+                        handler_.OnKey(ParseString());
+                        if (!NextToken(c))
+                        {
+                            break;
+                        }
+                        if (c != ':')
+                        {
+                            throw ParsingError("Expected ':'");
+                        }
+                        if (!NextToken(c))
+                        {
+                            break;
+                        }
+                    }
+                    StartValue(c);
+                    first = c == '[' || c == '{';
+                }
+                if (!stack_.empty())
+                {
+                    throw ParsingError(stack_.back() ? "Expected ']'" : "Expected '}'");
+                }
+            }
+
+            // Позиция сразу за корневым значением, после Parse
+            const char *GetEnd() const
+            {
+                return pos_;
+            }
+
+        private:
+            // Переходит к следующей значимой позиции и ставит pos_ сразу за ней
+            bool NextToken(char &c)
+            {
+                if (next_ == index_.size())
+                {
+                    return false;
+                }
+                pos_ = input_.data() + index_[next_++];
+                c = *pos_++;
+                return true;
+            }
+
+            // Скалярное значение разбирается сразу, контейнер только открывается
+            void StartValue(char c)
+            {
+                if (c == '[')
+                {
+                    CheckDepth(stack_.size(), max_depth_);
+                    handler_.OnStartArray();
+                    stack_.push_back(true);
+                }
+                else if (c == '{')
+                {
+                    CheckDepth(stack_.size(), max_depth_);
+                    handler_.OnStartObject();
+                    stack_.push_back(false);
+                }
+                else if (c == '"')
+                {
+                    handler_.OnString(ParseString());
+                }
+                else if (c == 'n' || c == 't' || c == 'f')
+                {
+                    EmitLiteral(ReadRun(IsLiteralChar), handler_);
+                    CheckScalarEnd();
+                }
+                else if (IsNumberStart(c))
+                {
+                    EmitNumber(ReadRun(IsNumberChar), handler_);
+                    CheckScalarEnd();
+                }
+                else
+                {
+                    throw ParsingError("Unexpected symbol");
+                }
+            }
+
+            // Символы, которые продолжают число или литерал, но не входят в него, индекс не видит:
+            // они не значимые позиции. Поэтому за скаляром внутри контейнера проверяется, что дальше
+            // идёт пробел, структурный символ или кавычка, как сделал бы EventParser.
+            // После корневого значения вход не читается
+            void CheckScalarEnd() const
+            {
+                const char *end = input_.data() + input_.size();
+                if (!stack_.empty() && pos_ != end && !IsScalarEnd(*pos_))
+                {
+                    throw ParsingError(stack_.back() ? "Expected ',' or ']'" : "Expected ',' or '}'");
+                }
+            }
+
+            // Токен от текущей позиции индекса до первого символа, который его не продолжает
+            std::string_view ReadRun(bool (*is_run_char)(char))
+            {
+                const char *begin = pos_ - 1;
+                const char *end = input_.data() + input_.size();
+                while (pos_ != end && is_run_char(*pos_))
+                {
+                    ++pos_;
+                }
+                return {begin, static_cast<size_t>(pos_ - begin)};
+            }
+
+            std::string_view ParseString()
+            {
+                const char *end = input_.data() + input_.size();
+                const char *special = FindStringSpecial(pos_, end);
+                if (special != end && *special == '"')
+                {
+                    const std::string_view value(pos_, static_cast<size_t>(special - pos_));
+                    pos_ = special + 1;
+                    return value;
+                }
+                buffer_.assign(pos_, special);
+                pos_ = special;
+                StringEscape escape;
+                if (!DecodeString(pos_, end, buffer_, escape))
+                {
+                    throw ParsingError("String parsing error");
+                }
+                return buffer_;
+            }
+
+            std::string_view input_;
+            const std::vector<uint32_t> &index_;
+            Handler &handler_;
+            size_t max_depth_;
+            // true - массив, false - словарь
+            std::vector<bool> stack_;
+            size_t next_ = 0;
+            const char *pos_ = nullptr;
+            std::string buffer_;
+        };
+
+        // Разбирает data в документ (определена в json.cpp). input_storage владеет data,
+        // после разбора он нужен документу только при заимствовании строк.
+        // При whole_input после корневого значения допускаются только пробелы
+        Document LoadDocument(std::string_view data, const LoadOptions &options, std::shared_ptr<const void> input_storage, bool whole_input = false);
+
+    } // namespace detail
+
+} // namespace json
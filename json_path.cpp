@@ -0,0 +1,393 @@
+#include "json_path.h"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        using detail::PathStep;
+
+        constexpr size_t kNoIndex = std::numeric_limits<size_t>::max();
+
+        // Номер элемента без знака и ведущих нулей, как требует RFC 6901, или kNoIndex
+        size_t ParseIndex(std::string_view token)
+        {
+            if (token.empty() || (token.size() > 1 && token[0] == '0'))
+            {
+                return kNoIndex;
+            }
+            size_t index = 0;
+            for (char c : token)
+            {
+                if (c < '0' || c > '9' || index > (kNoIndex - 1 - static_cast<size_t>(c - '0')) / 10)
+                {
+                    return kNoIndex;
+                }
+                index = index * 10 + static_cast<size_t>(c - '0');
+            }
+            return index;
+        }
+
+        std::vector<PathStep> ParsePointer(std::string_view pointer)
+        {
+            std::vector<PathStep> steps;
+            if (pointer.empty())
+            {
+                return steps;
+            }
+            if (pointer[0] != '/')
+            {
+                throw ParsingError("Invalid JSON pointer");
+            }
+            size_t pos = 1;
+            while (true)
+            {
+                const size_t slash = std::min(pointer.find('/', pos), pointer.size());
+                PathStep step;
+                step.kind = PathStep::Kind::Member;
+                // ~1 означает /, ~0 - ~
+                for (size_t i = pos; i < slash; ++i)
+                {
+                    if (pointer[i] != '~')
+                    {
+                        step.key.push_back(pointer[i]);
+                        continue;
+                    }
+                    if (i + 1 == slash || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                    {
+                        throw ParsingError("Invalid JSON pointer");
+                    }
+                    step.key.push_back(pointer[++i] == '0' ? '~' : '/');
+                }
+                step.index = ParseIndex(step.key);
+                steps.push_back(move(step));
+                if (slash == pointer.size())
+                {
+                    return steps;
+                }
+                pos = slash + 1;
+            }
+        }
+
+        // Разбор запроса JSONPath
+        class PathParser
+        {
+        public:
+            explicit PathParser(std::string_view path)
+                : path_(path) {}
+
+            std::vector<PathStep> Parse()
+            {
+                if (path_.empty() || path_[0] != '$')
+                {
+                    Fail();
+                }
+                pos_ = 1;
+                while (pos_ != path_.size())
+                {
+                    PathStep step;
+                    if (path_[pos_] == '.')
+                    {
+                        ++pos_;
+                        if (pos_ != path_.size() && path_[pos_] == '.')
+                        {
+                            ++pos_;
+                            step.descendant = true;
+                            if (pos_ != path_.size() && path_[pos_] == '[')
+                            {
+                                ParseBracket(step);
+                                steps_.push_back(move(step));
+                                continue;
+                            }
+                        }
+                        ParseName(step);
+                    }
+                    else if (path_[pos_] == '[')
+                    {
+                        ParseBracket(step);
+                    }
+                    else
+                    {
+                        Fail();
+                    }
+                    steps_.push_back(move(step));
+                }
+                return move(steps_);
+            }
+
+        private:
+            [[noreturn]] void Fail() const
+            {
+                throw ParsingError("Invalid JSONPath "s + std::string(path_));
+            }
+
+            // Имя после точки или звёздочка
+            void ParseName(PathStep &step)
+            {
+                if (pos_ != path_.size() && path_[pos_] == '*')
+                {
+                    ++pos_;
+                    step.kind = PathStep::Kind::Wildcard;
+                    return;
+                }
+                const size_t begin = pos_;
+                while (pos_ != path_.size() && path_[pos_] != '.' && path_[pos_] != '[')
+                {
+                    ++pos_;
+                }
+                if (pos_ == begin)
+                {
+                    Fail();
+                }
+                step.kind = PathStep::Kind::Key;
+                step.key = path_.substr(begin, pos_ - begin);
+            }
+
+            // [*], [3], ['name'] или ["name"]
+            void ParseBracket(PathStep &step)
+            {
+                ++pos_;
+                if (pos_ == path_.size())
+                {
+                    Fail();
+                }
+                const char c = path_[pos_];
+                if (c == '*')
+                {
+                    ++pos_;
+                    step.kind = PathStep::Kind::Wildcard;
+                }
+                else if (c == '\'' || c == '"')
+                {
+                    step.kind = PathStep::Kind::Key;
+                    ParseQuoted(c, step.key);
+                }
+                else
+                {
+                    const size_t begin = pos_;
+                    while (pos_ != path_.size() && path_[pos_] != ']')
+                    {
+                        ++pos_;
+                    }
+                    step.kind = PathStep::Kind::Index;
+                    step.index = ParseIndex(path_.substr(begin, pos_ - begin));
+                    if (step.index == kNoIndex)
+                    {
+                        Fail();
+                    }
+                }
+                if (pos_ == path_.size() || path_[pos_] != ']')
+                {
+                    Fail();
+                }
+                ++pos_;
+            }
+
+            // Строка в кавычках; обратная косая черта экранирует следующий символ
+            void ParseQuoted(char quote, std::string &key)
+            {
+                ++pos_;
+                while (pos_ != path_.size() && path_[pos_] != quote)
+                {
+                    if (path_[pos_] == '\\' && ++pos_ == path_.size())
+                    {
+                        break;
+                    }
+                    key.push_back(path_[pos_++]);
+                }
+                if (pos_ == path_.size())
+                {
+                    Fail();
+                }
+                ++pos_;
+            }
+
+            std::string_view path_;
+            size_t pos_ = 0;
+            std::vector<PathStep> steps_;
+        };
+
+        // Значение по ключу словаря
+        template <typename Value, typename Fn>
+        void VisitKey(const Value &node, std::string_view key, Fn &&fn)
+        {
+            decltype(auto) object = node.AsMap();
+            const auto it = object.find(key);
+            if (it != object.end())
+            {
+                fn(it->second);
+            }
+        }
+
+        // Элемент массива: у Node и снимка - сразу по номеру, у ленивого массива - обходом,
+        // который пропускает предыдущие элементы без разбора
+        template <typename Value, typename Fn>
+        void VisitItem(const Value &node, size_t index, Fn &&fn)
+        {
+            decltype(auto) array = node.AsArray();
+            if constexpr (std::is_same_v<Value, LazyNode>)
+            {
+                for (const LazyNode &item : array)
+                {
+                    if (index-- == 0)
+                    {
+                        fn(item);
+                        return;
+                    }
+                }
+            }
+            else if (index < array.size())
+            {
+                fn(array[index]);
+            }
+        }
+
+        template <typename Value, typename Fn>
+        void VisitChildren(const Value &node, Fn &&fn)
+        {
+            if (node.IsMap())
+            {
+                for (const auto &[key, item] : node.AsMap())
+                {
+                    fn(item);
+                }
+            }
+            else if (node.IsArray())
+            {
+                for (const auto &item : node.AsArray())
+                {
+                    fn(item);
+                }
+            }
+        }
+
+        // Применяет шаги, начиная с step, и передаёт emit каждое найденное значение.
+        // Значение не того типа просто не совпадает с шагом
+        template <typename Value, typename Emit>
+        void Evaluate(const std::vector<PathStep> &steps, size_t step, const Value &node, Emit &emit)
+        {
+            if (step == steps.size())
+            {
+                emit(node);
+                return;
+            }
+            const PathStep &current = steps[step];
+            const auto next = [&](const Value &child)
+            {
+                Evaluate(steps, step + 1, child, emit);
+            };
+            switch (current.kind)
+            {
+            case PathStep::Kind::Key:
+                if (node.IsMap())
+                {
+                    VisitKey(node, current.key, next);
+                }
+                break;
+            case PathStep::Kind::Index:
+                if (node.IsArray())
+                {
+                    VisitItem(node, current.index, next);
+                }
+                break;
+            case PathStep::Kind::Member:
+                if (node.IsMap())
+                {
+                    VisitKey(node, current.key, next);
+                }
+                else if (node.IsArray() && current.index != kNoIndex)
+                {
+                    VisitItem(node, current.index, next);
+                }
+                break;
+            case PathStep::Kind::Wildcard:
+                VisitChildren(node, next);
+                break;
+            }
+            if (current.descendant)
+            {
+                VisitChildren(node, [&](const Value &child)
+                              { Evaluate(steps, step, child, emit); });
+            }
+        }
+
+        template <typename Value, typename Result>
+        void SelectAll(const std::vector<PathStep> &steps, const Value &root, std::vector<Result> &result)
+        {
+            auto emit = [&result](const Value &value)
+            {
+                if constexpr (std::is_pointer_v<Result>)
+                {
+                    result.push_back(&value);
+                }
+                else
+                {
+                    result.push_back(value);
+                }
+            };
+            Evaluate(steps, 0, root, emit);
+        }
+
+        // У указателя не больше одного совпадения
+        template <typename Value>
+        std::optional<Value> FindOne(const std::vector<PathStep> &steps, const Value &root)
+        {
+            std::optional<Value> found;
+            auto emit = [&found](const Value &value)
+            {
+                found = value;
+            };
+            Evaluate(steps, 0, root, emit);
+            return found;
+        }
+
+    } // namespace
+
+    Pointer::Pointer(std::string_view pointer)
+        : steps_(ParsePointer(pointer)) {}
+
+    const Node *Pointer::Find(const Node &root) const
+    {
+        const Node *found = nullptr;
+        auto emit = [&found](const Node &value)
+        {
+            found = &value;
+        };
+        Evaluate(steps_, 0, root, emit);
+        return found;
+    }
+
+    std::optional<LazyNode> Pointer::Find(const LazyNode &root) const
+    {
+        return FindOne(steps_, root);
+    }
+
+    std::optional<SnapshotNode> Pointer::Find(const SnapshotNode &root) const
+    {
+        return FindOne(steps_, root);
+    }
+
+    Path::Path(std::string_view path)
+        : steps_(PathParser(path).Parse()) {}
+
+    void Path::Select(const Node &root, std::vector<const Node *> &result) const
+    {
+        SelectAll(steps_, root, result);
+    }
+
+    void Path::Select(const LazyNode &root, std::vector<LazyNode> &result) const
+    {
+        SelectAll(steps_, root, result);
+    }
+
+    void Path::Select(const SnapshotNode &root, std::vector<SnapshotNode> &result) const
+    {
+        SelectAll(steps_, root, result);
+    }
+
+} // namespace json
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "json.h"
+#include "json_lazy.h"
+#include "json_snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+    namespace detail
+    {
+        // Шаг разобранного запроса
+        struct PathStep
+        {
+            enum class Kind : uint8_t
+            {
+                // Значение по ключу словаря
+                Key,
+                // Элемент массива по номеру
+                Index,
+                // Шаг указателя: ключ для словаря, номер для массива, если ключ - число
+                Member,
+                // Все значения словаря или все элементы массива
+                Wildcard,
+            };
+
+            Kind kind = Kind::Key;
+            // Шаг применяется к узлу и ко всем его потомкам (.. в JSONPath)
+            bool descendant = false;
+            std::string key;
+            size_t index = 0;
+        };
+
+    } // namespace detail
+
+    // Указатель JSON (RFC 6901), например "/items/3/name". Разбирается один раз при создании,
+    // поиск по документу ничего не выделяет. Пустая строка указывает на корень.
+    // Несуществующий путь или значение не того типа дают пустой результат, а не исключение
+    class Pointer
+    {
+    public:
+        // Бросает ParsingError, если указатель записан неверно
+        explicit Pointer(std::string_view pointer);
+
+        const Node *Find(const Node &root) const;
+        // Пропущенные значения ленивого документа не разбираются
+        std::optional<LazyNode> Find(const LazyNode &root) const;
+        std::optional<SnapshotNode> Find(const SnapshotNode &root) const;
+
+    private:
+        std::vector<detail::PathStep> steps_;
+    };
+
+    // Запрос JSONPath. Поддерживается подмножество: корень $, ключ .name или ['name'],
+    // номер элемента [3], все дочерние значения .* или [*] и спуск ко всем потомкам ..name,
+    // ..* или ..[3]. Запрос разбирается один раз, а выполняется над любым числом документов.
+    // Найденные значения дописываются в result в порядке обхода документа: если переиспользовать
+    // result между вызовами, выполнение не выделяет память
+    class Path
+    {
+    public:
+        // Бросает ParsingError, если запрос записан неверно или выходит за подмножество
+        explicit Path(std::string_view path);
+
+        void Select(const Node &root, std::vector<const Node *> &result) const;
+        // Пропущенные значения ленивого документа не разбираются
+        void Select(const LazyNode &root, std::vector<LazyNode> &result) const;
+        void Select(const SnapshotNode &root, std::vector<SnapshotNode> &result) const;
+
+    private:
+        std::vector<detail::PathStep> steps_;
+    };
+
+} // namespace json
@@ -0,0 +1,30 @@
+#include "json_sax.h"
+
+namespace json
+{
+    SaxParser::SaxParser(Handler &handler)
+        : parser_(handler) {}
+
+    void SaxParser::Feed(std::string_view chunk)
+    {
+        parser_.Feed(chunk);
+    }
+
+    void SaxParser::Finish()
+    {
+        parser_.Finish();
+    }
+
+    bool SaxParser::IsDone() const
+    {
+        return parser_.IsDone();
+    }
+
+    void Parse(std::string_view input, Handler &handler)
+    {
+        SaxParser parser(handler);
+        parser.Feed(input);
+        parser.Finish();
+    }
+
+} // namespace json
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace json
+{
+    // Получатель событий потокового разбора. По умолчанию все события пропускаются,
+    // поэтому достаточно переопределить только нужные.
+    // string_view в OnString и OnKey действителен только до возврата из обработчика
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void OnNull() {}
+        virtual void OnBool(bool /*value*/) {}
+        virtual void OnInt(int64_t /*value*/) {}
+        virtual void OnDouble(double /*value*/) {}
+        virtual void OnString(std::string_view /*value*/) {}
+        virtual void OnKey(std::string_view /*key*/) {}
+        virtual void OnStartArray() {}
+        virtual void OnEndArray() {}
+        virtual void OnStartObject() {}
+        virtual void OnEndObject() {}
+    };
+
+    // Разбор без построения документа. Текст можно подавать кусками произвольного размера,
+    // например по мере чтения из сети; ошибки сообщаются через ParsingError
+    class SaxParser
+    {
+    public:
+        explicit SaxParser(Handler &handler);
+
+        void Feed(std::string_view chunk);
+        // Сообщает, что текст закончился. Бросает ParsingError, если значение не завершено
+        void Finish();
+        // Корневое значение разобрано целиком
+        bool IsDone() const;
+
+    private:
+        detail::EventParser<Handler> parser_;
+    };
+
+    // Разбирает весь текст сразу
+    void Parse(std::string_view input, Handler &handler);
+
+} // namespace json
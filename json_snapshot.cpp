@@ -0,0 +1,674 @@
+#include "json_snapshot.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Заголовок: сигнатура, метка порядка байтов, версия и запись корня
+        constexpr char kMagic[8] = {'J', 'S', 'O', 'N', 'S', 'N', 'A', 'P'};
+        constexpr uint32_t kByteOrderMark = 0x01020304;
+        constexpr uint32_t kVersion = 1;
+        constexpr uint64_t kRootOffset = 16;
+        constexpr size_t kHeaderSize = 24;
+
+        // Младшие три бита записи. Блоки выровнены на 8 байт, поэтому у смещения они нулевые
+        constexpr uint64_t kTagMask = 7;
+        constexpr uint64_t kBlockTag = 0;
+        constexpr uint64_t kNullEntry = 1;
+        constexpr uint64_t kFalseEntry = 2;
+        constexpr uint64_t kTrueEntry = 3;
+        constexpr uint64_t kIntTag = 4;
+        // Целые из этого диапазона помещаются в запись рядом с тегом
+        constexpr int64_t kMinEntryInt = -(int64_t{1} << 60);
+        constexpr int64_t kMaxEntryInt = (int64_t{1} << 60) - 1;
+
+        // Блок начинается с 16-байтного заголовка: тип и число - длина строки,
+        // число элементов или само значение
+        enum BlockType : uint8_t
+        {
+            kStringBlock = 1,
+            kDoubleBlock,
+            kInt64Block,
+            kArrayBlock,
+            kObjectBlock,
+        };
+        constexpr uint64_t kBlockHeaderSize = 16;
+        constexpr uint64_t kPayloadOffset = 8;
+        constexpr uint64_t kArrayItemSize = 8;
+        constexpr uint64_t kObjectItemSize = 16;
+
+        [[noreturn]] void ThrowCorrupted()
+        {
+            throw ParsingError("Snapshot is corrupted");
+        }
+
+        template <typename Value>
+        Value ReadAt(std::string_view data, uint64_t offset)
+        {
+            if (offset > data.size() || data.size() - offset < sizeof(Value))
+            {
+                ThrowCorrupted();
+            }
+            Value value;
+            std::memcpy(&value, data.data() + offset, sizeof(Value));
+            return value;
+        }
+
+        // Запись дочернего значения. Блоки пишутся в порядке обхода, и блок контейнера выделяется
+        // раньше блоков его элементов, поэтому дочерний блок всегда лежит после родительского.
+        // Запись, ссылающаяся назад, - признак испорченного снимка: иначе цикл из контейнеров
+        // увёл бы обход в бесконечную рекурсию
+        uint64_t CheckChild(uint64_t entry, uint64_t parent_end)
+        {
+            if ((entry & kTagMask) == kBlockTag && entry < parent_end)
+            {
+                ThrowCorrupted();
+            }
+            return entry;
+        }
+
+        // Проверяет, что таблица из count элементов по item_size байт лежит внутри снимка
+        void CheckTable(std::string_view data, uint64_t table, uint64_t count, uint64_t item_size)
+        {
+            if (table > data.size() || count > (data.size() - table) / item_size)
+            {
+                ThrowCorrupted();
+            }
+        }
+
+        class SnapshotWriter
+        {
+        public:
+            explicit SnapshotWriter(std::string &buffer)
+                : buffer_(buffer) {}
+
+            void WriteDocument(const Node &root)
+            {
+                buffer_.clear();
+                Allocate(kHeaderSize);
+                std::memcpy(buffer_.data(), kMagic, sizeof(kMagic));
+                Store(sizeof(kMagic), kByteOrderMark);
+                Store(sizeof(kMagic) + sizeof(kByteOrderMark), kVersion);
+                const uint64_t root_entry = WriteValue(root);
+                Store(kRootOffset, root_entry);
+            }
+
+        private:
+            // Место под блок, выровненное на 8 байт. Промежутки заполняются нулями,
+            // поэтому одинаковые документы дают одинаковые снимки
+            uint64_t Allocate(size_t size)
+            {
+                const size_t offset = (buffer_.size() + 7) & ~size_t{7};
+                buffer_.resize(offset + size);
+                return offset;
+            }
+
+            template <typename Value>
+            void Store(uint64_t offset, Value value)
+            {
+                std::memcpy(buffer_.data() + offset, &value, sizeof(Value));
+            }
+
+            uint64_t WriteBlock(BlockType type, uint64_t payload, size_t extra)
+            {
+                const uint64_t offset = Allocate(kBlockHeaderSize + extra);
+                Store(offset, static_cast<uint8_t>(type));
+                Store(offset + kPayloadOffset, payload);
+                return offset;
+            }
+
+            uint64_t WriteString(std::string_view value)
+            {
+                const uint64_t offset = WriteBlock(kStringBlock, value.size(), value.size());
+                std::memcpy(buffer_.data() + offset + kBlockHeaderSize, value.data(), value.size());
+                return offset;
+            }
+
+            uint64_t WriteKey(std::string_view key)
+            {
+                const auto it = keys_.find(key);
+                if (it != keys_.end())
+                {
+                    return it->second;
+                }
+                const uint64_t offset = WriteString(key);
+                keys_.emplace(key, offset);
+                return offset;
+            }
+
+            uint64_t WriteInt(int64_t value)
+            {
+                if (value >= kMinEntryInt && value <= kMaxEntryInt)
+                {
+                    return (static_cast<uint64_t>(value) << 3) | kIntTag;
+                }
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                return WriteBlock(kInt64Block, bits, 0);
+            }
+
+            // Возвращает запись значения. Таблица контейнера выделяется до его элементов
+            // и заполняется по мере их записи
+            uint64_t WriteValue(const Node &node)
+            {
+                return node.Visit([this](const auto &value) -> uint64_t
+                                  {
+                    using Value = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<Value, std::nullptr_t>)
+                    {
+                        return kNullEntry;
+                    }
+                    else if constexpr (std::is_same_v<Value, bool>)
+                    {
+                        return value ? kTrueEntry : kFalseEntry;
+                    }
+                    else if constexpr (std::is_same_v<Value, int> || std::is_same_v<Value, int64_t>)
+                    {
+                        return WriteInt(value);
+                    }
+                    else if constexpr (std::is_same_v<Value, double>)
+                    {
+                        uint64_t bits;
+                        std::memcpy(&bits, &value, sizeof(bits));
+                        return WriteBlock(kDoubleBlock, bits, 0);
+                    }
+                    else if constexpr (std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+                    {
+                        return WriteString(value);
+                    }
+                    else if constexpr (std::is_same_v<Value, Array>)
+                    {
+                        const uint64_t offset = WriteBlock(kArrayBlock, value.size(), value.size() * kArrayItemSize);
+                        uint64_t item_offset = offset + kBlockHeaderSize;
+                        for (const Node &item : value)
+                        {
+                            const uint64_t entry = WriteValue(item);
+                            Store(item_offset, entry);
+                            item_offset += kArrayItemSize;
+                        }
+                        return offset;
+                    }
+                    else
+                    {
+                        static_assert(std::is_same_v<Value, Dict>);
+                        const uint64_t offset = WriteBlock(kObjectBlock, value.size(), value.size() * kObjectItemSize);
+                        uint64_t item_offset = offset + kBlockHeaderSize;
+                        for (const auto &[key, item] : value)
+                        {
+                            const uint64_t key_offset = WriteKey(key);
+                            const uint64_t entry = WriteValue(item);
+                            Store(item_offset, key_offset);
+                            Store(item_offset + 8, entry);
+                            item_offset += kObjectItemSize;
+                        }
+                        return offset;
+                    } });
+            }
+
+            std::string &buffer_;
+            // Ключи указывают в сохраняемый документ, который живёт дольше записи
+            std::unordered_map<std::string_view, uint64_t> keys_;
+        };
+
+        std::string_view ReadString(std::string_view data, uint64_t offset)
+        {
+            if (ReadAt<uint8_t>(data, offset) != kStringBlock)
+            {
+                ThrowCorrupted();
+            }
+            const auto size = ReadAt<uint64_t>(data, offset + kPayloadOffset);
+            CheckTable(data, offset + kBlockHeaderSize, size, 1);
+            return data.substr(static_cast<size_t>(offset + kBlockHeaderSize), static_cast<size_t>(size));
+        }
+
+    } // namespace
+
+    std::string SaveSnapshot(const Document &doc)
+    {
+        std::string buffer;
+        SnapshotWriter writer(buffer);
+        writer.WriteDocument(doc.GetRoot());
+        return buffer;
+    }
+
+    void SaveSnapshotFile(const Document &doc, const std::string &path)
+    {
+        const std::string snapshot = SaveSnapshot(doc);
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            throw std::runtime_error("Failed to open file "s + path);
+        }
+        out.write(snapshot.data(), static_cast<std::streamsize>(snapshot.size()));
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write file "s + path);
+        }
+    }
+
+    SnapshotNode::SnapshotNode(std::string_view data, uint64_t entry)
+        : data_(data), entry_(entry) {}
+
+    uint8_t SnapshotNode::GetBlockType() const
+    {
+        return (entry_ & kTagMask) == kBlockTag ? ReadAt<uint8_t>(data_, entry_) : 0;
+    }
+
+    bool SnapshotNode::IsNull() const
+    {
+        return entry_ == kNullEntry;
+    }
+    bool SnapshotNode::IsBool() const
+    {
+        return entry_ == kFalseEntry || entry_ == kTrueEntry;
+    }
+    bool SnapshotNode::IsInt() const
+    {
+        if (!IsInt64())
+        {
+            return false;
+        }
+        const int64_t value = AsInt64();
+        return value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max();
+    }
+    bool SnapshotNode::IsInt64() const
+    {
+        return (entry_ & kTagMask) == kIntTag || GetBlockType() == kInt64Block;
+    }
+    bool SnapshotNode::IsDouble() const
+    {
+        return IsPureDouble() || IsInt64();
+    }
+    bool SnapshotNode::IsPureDouble() const
+    {
+        return GetBlockType() == kDoubleBlock;
+    }
+    bool SnapshotNode::IsString() const
+    {
+        return GetBlockType() == kStringBlock;
+    }
+    bool SnapshotNode::IsArray() const
+    {
+        return GetBlockType() == kArrayBlock;
+    }
+    bool SnapshotNode::IsMap() const
+    {
+        return GetBlockType() == kObjectBlock;
+    }
+
+    bool SnapshotNode::AsBool() const
+    {
+        if (IsBool())
+            return entry_ == kTrueEntry;
+        throw std::logic_error("Logic error");
+    }
+    int SnapshotNode::AsInt() const
+    {
+        if (IsInt())
+            return static_cast<int>(AsInt64());
+        throw std::logic_error("Logic error");
+    }
+    int64_t SnapshotNode::AsInt64() const
+    {
+        if ((entry_ & kTagMask) == kIntTag)
+            return static_cast<int64_t>(entry_) >> 3;
+        if (GetBlockType() == kInt64Block)
+            return ReadAt<int64_t>(data_, entry_ + kPayloadOffset);
+        throw std::logic_error("Logic error");
+    }
+    double SnapshotNode::AsDouble() const
+    {
+        if (IsPureDouble())
+            return ReadAt<double>(data_, entry_ + kPayloadOffset);
+        if (IsInt64())
+            return static_cast<double>(AsInt64());
+        throw std::logic_error("Logic error");
+    }
+    std::string_view SnapshotNode::AsString() const
+    {
+        if (IsString())
+            return ReadString(data_, entry_);
+        throw std::logic_error("Logic error");
+    }
+    SnapshotArray SnapshotNode::AsArray() const
+    {
+        if (!IsArray())
+            throw std::logic_error("Logic error");
+        const auto size = ReadAt<uint64_t>(data_, entry_ + kPayloadOffset);
+        CheckTable(data_, entry_ + kBlockHeaderSize, size, kArrayItemSize);
+        return SnapshotArray(data_, entry_ + kBlockHeaderSize, static_cast<size_t>(size));
+    }
+    SnapshotObject SnapshotNode::AsMap() const
+    {
+        if (!IsMap())
+            throw std::logic_error("Logic error");
+        const auto size = ReadAt<uint64_t>(data_, entry_ + kPayloadOffset);
+        CheckTable(data_, entry_ + kBlockHeaderSize, size, kObjectItemSize);
+        return SnapshotObject(data_, entry_ + kBlockHeaderSize, static_cast<size_t>(size));
+    }
+
+    SnapshotNode SnapshotNode::operator[](std::string_view key) const
+    {
+        return AsMap().at(key);
+    }
+
+    SnapshotNode SnapshotNode::operator[](size_t index) const
+    {
+        return AsArray().at(index);
+    }
+
+    // Каждое значение целого снимка занимает свою запись, а строка - свой блок, поэтому
+    // обход тратит из budget байты записи и строки. Если бюджета, равного размеру снимка,
+    // не хватило, несколько записей ссылаются на один блок, и копия выросла бы экспоненциально
+    Node SnapshotNode::ToNode(size_t depth, size_t max_depth, size_t &budget) const
+    {
+        const uint8_t block_type = GetBlockType();
+        if ((block_type == kArrayBlock || block_type == kObjectBlock) && max_depth != 0 && depth >= max_depth)
+        {
+            throw ParsingError("Maximum nesting depth exceeded");
+        }
+        const size_t cost = kArrayItemSize + (block_type == kStringBlock ? AsString().size() : 0);
+        if (cost > budget)
+        {
+            ThrowCorrupted();
+        }
+        budget -= cost;
+        switch (block_type)
+        {
+        case kStringBlock:
+            return Node(std::string(AsString()));
+        case kDoubleBlock:
+            return Node(AsDouble());
+        case kArrayBlock:
+        {
+            const SnapshotArray array = AsArray();
+            Array result;
+            result.reserve(array.size());
+            for (const SnapshotNode &item : array)
+            {
+                result.push_back(item.ToNode(depth + 1, max_depth, budget));
+            }
+            return Node(move(result));
+        }
+        case kObjectBlock:
+        {
+            const SnapshotObject object = AsMap();
+            Dict::Entries entries;
+            entries.reserve(object.size());
+            for (const auto &[key, item] : object)
+            {
+                entries.emplace_back(Key(key), item.ToNode(depth + 1, max_depth, budget));
+            }
+            return Node(Dict(move(entries)));
+        }
+        default:
+            break;
+        }
+        if (IsNull())
+            return Node(nullptr);
+        if (IsBool())
+            return Node(AsBool());
+        if (IsInt64())
+            return Node(AsInt64());
+        ThrowCorrupted();
+    }
+
+    Document SnapshotNode::Materialize(const LoadOptions &options) const
+    {
+        size_t budget = data_.size();
+        return Document{ToNode(0, options.max_depth, budget)};
+    }
+
+    SnapshotArray::SnapshotArray(std::string_view data, uint64_t table, size_t size)
+        : data_(data), table_(table), size_(size) {}
+
+    SnapshotArray::const_iterator SnapshotArray::begin() const
+    {
+        return const_iterator(*this, 0);
+    }
+
+    SnapshotArray::const_iterator SnapshotArray::end() const
+    {
+        return const_iterator(*this, size_);
+    }
+
+    size_t SnapshotArray::size() const
+    {
+        return size_;
+    }
+
+    bool SnapshotArray::empty() const
+    {
+        return size_ == 0;
+    }
+
+    SnapshotNode SnapshotArray::at(size_t index) const
+    {
+        if (index >= size_)
+        {
+            throw std::out_of_range("Array index is out of range");
+        }
+        return (*this)[index];
+    }
+
+    SnapshotNode SnapshotArray::operator[](size_t index) const
+    {
+        return SnapshotNode(data_, CheckChild(ReadAt<uint64_t>(data_, table_ + index * kArrayItemSize), table_ + size_ * kArrayItemSize));
+    }
+
+    SnapshotArray::const_iterator::const_iterator(const SnapshotArray &array, size_t index)
+        : array_(array), index_(index)
+    {
+        Settle();
+    }
+
+    void SnapshotArray::const_iterator::Settle()
+    {
+        if (index_ < array_.size())
+        {
+            node_ = array_[index_];
+        }
+    }
+
+    SnapshotArray::const_iterator::reference SnapshotArray::const_iterator::operator*() const
+    {
+        return node_;
+    }
+
+    SnapshotArray::const_iterator::pointer SnapshotArray::const_iterator::operator->() const
+    {
+        return &node_;
+    }
+
+    SnapshotArray::const_iterator &SnapshotArray::const_iterator::operator++()
+    {
+        ++index_;
+        Settle();
+        return *this;
+    }
+
+    SnapshotArray::const_iterator SnapshotArray::const_iterator::operator++(int)
+    {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool SnapshotArray::const_iterator::operator==(const const_iterator &rhs) const
+    {
+        return index_ == rhs.index_;
+    }
+
+    bool SnapshotArray::const_iterator::operator!=(const const_iterator &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    SnapshotObject::SnapshotObject(std::string_view data, uint64_t table, size_t size)
+        : data_(data), table_(table), size_(size) {}
+
+    std::string_view SnapshotObject::GetKey(size_t index) const
+    {
+        return ReadString(data_, ReadAt<uint64_t>(data_, table_ + index * kObjectItemSize));
+    }
+
+    SnapshotNode SnapshotObject::GetValue(size_t index) const
+    {
+        return SnapshotNode(data_, CheckChild(ReadAt<uint64_t>(data_, table_ + index * kObjectItemSize + 8), table_ + size_ * kObjectItemSize));
+    }
+
+    SnapshotObject::const_iterator SnapshotObject::begin() const
+    {
+        return const_iterator(*this, 0);
+    }
+
+    SnapshotObject::const_iterator SnapshotObject::end() const
+    {
+        return const_iterator(*this, size_);
+    }
+
+    size_t SnapshotObject::size() const
+    {
+        return size_;
+    }
+
+    bool SnapshotObject::empty() const
+    {
+        return size_ == 0;
+    }
+
+    SnapshotObject::const_iterator SnapshotObject::find(std::string_view key) const
+    {
+        size_t first = 0;
+        size_t last = size_;
+        while (first < last)
+        {
+            const size_t middle = first + (last - first) / 2;
+            if (GetKey(middle) < key)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        if (first == size_ || GetKey(first) != key)
+        {
+            return end();
+        }
+        return const_iterator(*this, first);
+    }
+
+    size_t SnapshotObject::count(std::string_view key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    SnapshotNode SnapshotObject::at(std::string_view key) const
+    {
+        const auto it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("Key is not found");
+        }
+        return it->second;
+    }
+
+    SnapshotObject::const_iterator::const_iterator(const SnapshotObject &object, size_t index)
+        : object_(object), index_(index)
+    {
+        Settle();
+    }
+
+    void SnapshotObject::const_iterator::Settle()
+    {
+        if (index_ < object_.size())
+        {
+            pair_ = {object_.GetKey(index_), object_.GetValue(index_)};
+        }
+    }
+
+    SnapshotObject::const_iterator::reference SnapshotObject::const_iterator::operator*() const
+    {
+        return pair_;
+    }
+
+    SnapshotObject::const_iterator::pointer SnapshotObject::const_iterator::operator->() const
+    {
+        return &pair_;
+    }
+
+    SnapshotObject::const_iterator &SnapshotObject::const_iterator::operator++()
+    {
+        ++index_;
+        Settle();
+        return *this;
+    }
+
+    SnapshotObject::const_iterator SnapshotObject::const_iterator::operator++(int)
+    {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool SnapshotObject::const_iterator::operator==(const const_iterator &rhs) const
+    {
+        return index_ == rhs.index_;
+    }
+
+    bool SnapshotObject::const_iterator::operator!=(const const_iterator &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    SnapshotDocument::SnapshotDocument(std::string_view data)
+        : SnapshotDocument(data, nullptr) {}
+
+    SnapshotDocument::SnapshotDocument(std::string_view data, std::shared_ptr<const void> storage)
+        : storage_(move(storage)), data_(data)
+    {
+        if (data.size() < kHeaderSize || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+        {
+            throw ParsingError("Not a snapshot");
+        }
+        if (ReadAt<uint32_t>(data, sizeof(kMagic)) != kByteOrderMark)
+        {
+            throw ParsingError("Snapshot has different byte order");
+        }
+        if (ReadAt<uint32_t>(data, sizeof(kMagic) + sizeof(kByteOrderMark)) != kVersion)
+        {
+            throw ParsingError("Unsupported snapshot version");
+        }
+        root_ = CheckChild(ReadAt<uint64_t>(data, kRootOffset), kHeaderSize);
+    }
+
+    SnapshotNode SnapshotDocument::GetRoot() const
+    {
+        return SnapshotNode(data_, root_);
+    }
+
+    SnapshotDocument LoadSnapshot(std::string_view data)
+    {
+        return SnapshotDocument(data);
+    }
+
+    SnapshotDocument LoadSnapshotFile(const std::string &path)
+    {
+        auto file = std::make_shared<MappedFile>(path);
+        const std::string_view data = file->GetData();
+        return SnapshotDocument(data, move(file));
+    }
+
+} // namespace json
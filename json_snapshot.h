@@ -0,0 +1,204 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace json
+{
+    // Снимок - плоское двоичное представление документа, по которому можно ходить сразу,
+    // без разбора. Каждое значение описывается 8-байтной записью: null, bool и целые
+    // до 61 бита хранятся в самой записи, остальное - смещением блока от начала снимка.
+    // Блок массива содержит таблицу записей элементов, блок словаря - отсортированную
+    // таблицу пар (смещение ключа, запись значения), поэтому элемент массива находится
+    // за O(1), а ключ - бинарным поиском. Одинаковые ключи хранятся один раз.
+    // Числа записываются в порядке байтов машины, где снимок сохранён
+    std::string SaveSnapshot(const Document &doc);
+    void SaveSnapshotFile(const Document &doc, const std::string &path);
+
+    class SnapshotArray;
+    class SnapshotObject;
+
+    // Значение снимка. Чтение проверяет границы, дочерний блок должен лежать после блока
+    // родителя, а Materialize обходит не больше байт, чем есть в снимке, поэтому испорченный
+    // снимок приводит к ParsingError, а не к чтению чужой памяти или бесконечному обходу.
+    // Действительно, пока жив SnapshotDocument, из которого получено
+    class SnapshotNode
+    {
+    public:
+        SnapshotNode() = default;
+        // data - весь снимок, entry - запись значения
+        SnapshotNode(std::string_view data, uint64_t entry);
+
+        bool IsNull() const;
+        bool IsBool() const;
+        bool IsInt() const;
+        bool IsInt64() const;
+        bool IsDouble() const;
+        bool IsPureDouble() const;
+        bool IsString() const;
+        bool IsArray() const;
+        bool IsMap() const;
+
+        bool AsBool() const;
+        int AsInt() const;
+        int64_t AsInt64() const;
+        double AsDouble() const;
+        // Строка лежит в снимке и не копируется
+        std::string_view AsString() const;
+        SnapshotArray AsArray() const;
+        SnapshotObject AsMap() const;
+
+        // Бросают std::out_of_range, если такого значения нет
+        SnapshotNode operator[](std::string_view key) const;
+        SnapshotNode operator[](size_t index) const;
+
+        // Копирует значение в обычный документ. Вложенность ограничена options.max_depth,
+        // как у Load (остальные параметры не действуют)
+        Document Materialize(const LoadOptions &options = {}) const;
+
+    private:
+        // Тип блока, на который ссылается запись, или 0 для значения внутри записи
+        uint8_t GetBlockType() const;
+        // depth - сколько контейнеров над значением, budget - сколько байт снимка ещё можно обойти
+        Node ToNode(size_t depth, size_t max_depth, size_t &budget) const;
+
+        std::string_view data_;
+        uint64_t entry_ = 0;
+    };
+
+    // Массив снимка: размер известен сразу, элемент находится по номеру без обхода
+    class SnapshotArray
+    {
+    public:
+        class const_iterator;
+
+        // table - смещение таблицы записей элементов
+        SnapshotArray(std::string_view data, uint64_t table, size_t size);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        // Бросает std::out_of_range
+        SnapshotNode at(size_t index) const;
+        SnapshotNode operator[](size_t index) const;
+
+    private:
+        std::string_view data_;
+        uint64_t table_;
+        size_t size_;
+    };
+
+    class SnapshotArray::const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SnapshotNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const SnapshotNode *;
+        using reference = const SnapshotNode &;
+
+        const_iterator(const SnapshotArray &array, size_t index);
+
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator &rhs) const;
+        bool operator!=(const const_iterator &rhs) const;
+
+    private:
+        void Settle();
+
+        SnapshotArray array_;
+        size_t index_;
+        SnapshotNode node_;
+    };
+
+    // Словарь снимка. Пары перебираются в порядке ключей, как в Dict
+    class SnapshotObject
+    {
+    public:
+        using value_type = std::pair<std::string_view, SnapshotNode>;
+        class const_iterator;
+
+        // table - смещение таблицы пар
+        SnapshotObject(std::string_view data, uint64_t table, size_t size);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        // Бинарный поиск по ключам
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        // Бросает std::out_of_range
+        SnapshotNode at(std::string_view key) const;
+
+    private:
+        friend class const_iterator;
+
+        std::string_view GetKey(size_t index) const;
+        SnapshotNode GetValue(size_t index) const;
+
+        std::string_view data_;
+        uint64_t table_;
+        size_t size_;
+    };
+
+    class SnapshotObject::const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SnapshotObject::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        const_iterator(const SnapshotObject &object, size_t index);
+
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator &rhs) const;
+        bool operator!=(const const_iterator &rhs) const;
+
+    private:
+        void Settle();
+
+        SnapshotObject object_;
+        size_t index_;
+        value_type pair_;
+    };
+
+    // Снимок, открытый для чтения. Конструктор проверяет только заголовок,
+    // так что открытие не зависит от размера снимка
+    class SnapshotDocument
+    {
+    public:
+        // Данные не копируются и должны жить дольше документа
+        explicit SnapshotDocument(std::string_view data);
+        // storage владеет памятью, в которой лежат данные
+        SnapshotDocument(std::string_view data, std::shared_ptr<const void> storage);
+
+        SnapshotNode GetRoot() const;
+
+    private:
+        std::shared_ptr<const void> storage_;
+        std::string_view data_;
+        uint64_t root_;
+    };
+
+    SnapshotDocument LoadSnapshot(std::string_view data);
+    // Файл отображается в память и остаётся в ней, пока жив документ
+    SnapshotDocument LoadSnapshotFile(const std::string &path);
+
+} // namespace json
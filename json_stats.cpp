@@ -0,0 +1,161 @@
+#include "json_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        struct StatsHooks
+        {
+            ParseStatsHook on_parse;
+            PrintStatsHook on_print;
+        };
+
+        // Обработчики заменяются целиком: вызов держит свою копию и не мешает замене
+        std::mutex hooks_mutex;
+        std::shared_ptr<const StatsHooks> hooks;
+        // Проверяются на каждом разборе, поэтому без блокировки
+        std::atomic<bool> has_parse_hook{false};
+        std::atomic<bool> has_print_hook{false};
+
+        std::shared_ptr<const StatsHooks> GetHooks()
+        {
+            const std::lock_guard lock(hooks_mutex);
+            return hooks;
+        }
+
+        size_t CountStringBlocks(const std::string &str)
+        {
+            static const size_t sso_capacity = std::string().capacity();
+            return str.capacity() > sso_capacity ? 2 : 1;
+        }
+
+    } // namespace
+
+    void SetStatsHooks(ParseStatsHook on_parse, PrintStatsHook on_print)
+    {
+        const bool parse = static_cast<bool>(on_parse);
+        const bool print = static_cast<bool>(on_print);
+        auto new_hooks = std::make_shared<const StatsHooks>(StatsHooks{move(on_parse), move(on_print)});
+        {
+            const std::lock_guard lock(hooks_mutex);
+            hooks = move(new_hooks);
+        }
+        has_parse_hook.store(parse, std::memory_order_relaxed);
+        has_print_hook.store(print, std::memory_order_relaxed);
+    }
+
+    namespace detail
+    {
+        bool HasParseStatsHook() noexcept
+        {
+            return has_parse_hook.load(std::memory_order_relaxed);
+        }
+
+        bool HasPrintStatsHook() noexcept
+        {
+            return has_print_hook.load(std::memory_order_relaxed);
+        }
+
+        void ReportParseStats(const ParseStats &stats)
+        {
+            const auto current = GetHooks();
+            if (current != nullptr && current->on_parse)
+            {
+                current->on_parse(stats);
+            }
+        }
+
+        void ReportPrintStats(const PrintStats &stats)
+        {
+            const auto current = GetHooks();
+            if (current != nullptr && current->on_print)
+            {
+                current->on_print(stats);
+            }
+        }
+
+        size_t CountBlocks(const Node &node)
+        {
+            size_t blocks = 0;
+            std::vector<const Node *> pending{&node};
+            while (!pending.empty())
+            {
+                const Node *current = pending.back();
+                pending.pop_back();
+                switch (current->GetType())
+                {
+                case Node::Type::String:
+                    blocks += CountStringBlocks(current->AsString());
+                    break;
+                case Node::Type::Array:
+                {
+                    const Array &array = current->AsArray();
+                    blocks += array.capacity() > 0 ? 2 : 1;
+                    for (const Node &item : array)
+                    {
+                        pending.push_back(&item);
+                    }
+                    break;
+                }
+                case Node::Type::Dict:
+                {
+                    const Dict &dict = current->AsMap();
+                    blocks += 1 + (dict.GetBufferBytes() > 0 ? 1 : 0) + (dict.size() >= Dict::kIndexThreshold ? 1 : 0);
+                    for (const auto &[key, item] : dict)
+                    {
+                        blocks += key.GetHeapBytes() > 0 ? 1 : 0;
+                        pending.push_back(&item);
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            return blocks;
+        }
+
+        void CountNodes(const Node &node, size_t &nodes, size_t &max_depth)
+        {
+            nodes = 0;
+            max_depth = 0;
+            // Узел и число контейнеров, в которые он вложен
+            std::vector<std::pair<const Node *, size_t>> pending{{&node, 0}};
+            while (!pending.empty())
+            {
+                const auto [current, depth] = pending.back();
+                pending.pop_back();
+                ++nodes;
+                if (current->IsArray() || current->IsMap())
+                {
+                    max_depth = std::max(max_depth, depth + 1);
+                }
+                if (current->IsArray())
+                {
+                    for (const Node &item : current->AsArray())
+                    {
+                        pending.emplace_back(&item, depth + 1);
+                    }
+                }
+                else if (current->IsMap())
+                {
+                    for (const auto &[key, item] : current->AsMap())
+                    {
+                        pending.emplace_back(&item, depth + 1);
+                    }
+                }
+            }
+        }
+
+    } // namespace detail
+
+} // namespace json
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "json.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+namespace json
+{
+    // Счётчики одного разбора. Собираются, только если задан LoadOptions::stats или установлен
+    // обработчик SetStatsHooks; иначе разбор идёт без обёртки и замеры ничего не стоят.
+    // Load(std::istream) и IncrementalParser счётчиков не собирают
+    struct ParseStats
+    {
+        // Размер входа
+        size_t bytes = 0;
+        // Значения всех типов, включая массивы и словари
+        size_t nodes = 0;
+        size_t containers = 0;
+        size_t strings = 0;
+        size_t keys = 0;
+        size_t numbers = 0;
+        // Строки и ключи после раскодирования escape-последовательностей
+        size_t string_bytes = 0;
+        size_t max_depth = 0;
+        // Оценка по готовому дереву, а не число выделений памяти во время разбора: сколько
+        // блоков занимают вынесенные строки, контейнеры, их буферы и длинные ключи.
+        // Перевыделения буферов при росте и память самого парсера не учитываются. В документе
+        // с use_arena эти блоки взяты из арены, ключи из таблицы документа (intern_keys)
+        // и короткие ключи, хранящиеся в самом ключе, блоков не занимают
+        size_t blocks = 0;
+
+        // Время разбора целиком
+        std::chrono::nanoseconds total_time{0};
+        // Время до события делится по типу токена, которым оно закончилось: строки и ключи,
+        // числа, всё остальное (скобки, литералы, пробелы). При параллельном разборе
+        // время фаз складывается по всем потокам
+        std::chrono::nanoseconds string_time{0};
+        std::chrono::nanoseconds number_time{0};
+        // Построение структурного индекса (LoadOptions::use_structural_index)
+        std::chrono::nanoseconds index_time{0};
+    };
+
+    // Счётчики одного ToString или Print
+    struct PrintStats
+    {
+        // Длина текста
+        size_t bytes = 0;
+        size_t nodes = 0;
+        size_t max_depth = 0;
+        std::chrono::nanoseconds time{0};
+    };
+
+    using ParseStatsHook = std::function<void(const ParseStats &)>;
+    using PrintStatsHook = std::function<void(const PrintStats &)>;
+
+    // Обработчики вызываются после каждого удачного разбора и вывода в том потоке, где
+    // они прошли, поэтому должны быть потокобезопасными. Пустой обработчик отключает замеры.
+    // LoadLines вызывает обработчик на каждую запись, а LoadOptions::stats не заполняет
+    void SetStatsHooks(ParseStatsHook on_parse, PrintStatsHook on_print);
+
+    namespace detail
+    {
+        bool HasParseStatsHook() noexcept;
+        bool HasPrintStatsHook() noexcept;
+        void ReportParseStats(const ParseStats &stats);
+        void ReportPrintStats(const PrintStats &stats);
+
+        // Блоки памяти дерева (см. ParseStats::blocks)
+        size_t CountBlocks(const Node &node);
+        // Число узлов и наибольшая вложенность контейнеров
+        void CountNodes(const Node &node, size_t &nodes, size_t &max_depth);
+
+    } // namespace detail
+
+} // namespace json
@@ -0,0 +1,382 @@
+#include "json_validate.h"
+#include "json_parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Четыре шестнадцатеричные цифры после \u, без исключений
+        bool ReadHex4(const char *digits, uint32_t &code)
+        {
+            code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const int digit = detail::HexDigit(digits[i]);
+                if (digit < 0)
+                {
+                    return false;
+                }
+                code = code * 16 + static_cast<uint32_t>(digit);
+            }
+            return true;
+        }
+
+        // Тот же разбор, что у EventParser, но без обработчика: строки не раскодируются,
+        // числа переводятся, только если могут не поместиться в double, а ошибка возвращается
+        // статической строкой, поэтому ни корректный, ни испорченный вход не требуют памяти
+        class Validator
+        {
+        public:
+            Validator(std::string_view input, size_t max_depth)
+                : begin_(input.data()), pos_(input.data()), end_(input.data() + input.size()), max_depth_(max_depth) {}
+
+            // Возвращает текст ошибки или nullptr; при ошибке GetOffset указывает на её место
+            const char *Run()
+            {
+                pos_ = detail::SkipSpace(pos_, end_);
+                if (pos_ == end_)
+                {
+                    return "Unexpected end of input";
+                }
+                if (const char *error = StartValue())
+                {
+                    return error;
+                }
+                while (depth_ != 0)
+                {
+                    const bool is_array = IsArray();
+                    pos_ = detail::SkipSpace(pos_, end_);
+                    if (pos_ == end_)
+                    {
+                        return is_array ? "Expected ']'" : "Expected '}'";
+                    }
+                    if (*pos_ == (is_array ? ']' : '}'))
+                    {
+                        ++pos_;
+                        --depth_;
+                        first_ = false;
+                        continue;
+                    }
+                    // Элементы разделяются ровно одной запятой
+                    if (!first_)
+                    {
+                        if (*pos_ != ',')
+                        {
+                            return is_array ? "Expected ',' or ']'" : "Expected ',' or '}'";
+                        }
+                        pos_ = detail::SkipSpace(pos_ + 1, end_);
+                        if (pos_ == end_)
+                        {
+                            return is_array ? "Expected ']'" : "Expected '}'";
+                        }
+                    }
+                    if (!is_array)
+                    {
+                        if (const char *error = ScanKey())
+                        {
+                            return error;
+                        }
+                    }
+                    if (const char *error = StartValue())
+                    {
+                        return error;
+                    }
+                }
+                pos_ = detail::SkipSpace(pos_, end_);
+                return pos_ == end_ ? nullptr : "Redundant data after document";
+            }
+
+            size_t GetOffset() const
+            {
+                return static_cast<size_t>(pos_ - begin_);
+            }
+
+        private:
+            // Полностью проверяет скалярное значение или открывает контейнер
+            const char *StartValue()
+            {
+                const char c = *pos_;
+                if (c == '[' || c == '{')
+                {
+                    if (max_depth_ != 0 && depth_ >= max_depth_)
+                    {
+                        return "Maximum nesting depth exceeded";
+                    }
+                    Push(c == '[');
+                    ++pos_;
+                    first_ = true;
+                    return nullptr;
+                }
+                first_ = false;
+                if (c == '"')
+                {
+                    ++pos_;
+                    return ScanString();
+                }
+                if (c == 'n' || c == 't' || c == 'f')
+                {
+                    const std::string_view token = ReadRun<detail::IsLiteralChar>();
+                    if (const char *error = detail::CheckLiteral(token))
+                    {
+                        pos_ = token.data();
+                        return error;
+                    }
+                    return nullptr;
+                }
+                if (detail::IsNumberStart(c))
+                {
+                    const std::string_view token = ReadRun<detail::IsNumberChar>();
+                    if (const char *error = CheckNumber(token))
+                    {
+                        pos_ = token.data();
+                        return error;
+                    }
+                    return nullptr;
+                }
+                return "Unexpected symbol";
+            }
+
+            // Ключ, двоеточие и пробелы до значения
+            const char *ScanKey()
+            {
+                if (*pos_ != '"')
+                {
+                    return "String parsing error";
+                }
+                ++pos_;
+                if (const char *error = ScanString())
+                {
+                    return error;
+                }
+                pos_ = detail::SkipSpace(pos_, end_);
+                if (pos_ == end_)
+                {
+                    return "Expected '}'";
+                }
+                if (*pos_ != ':')
+                {
+                    return "Expected ':'";
+                }
+                pos_ = detail::SkipSpace(pos_ + 1, end_);
+                return pos_ == end_ ? "Expected '}'" : nullptr;
+            }
+
+            // pos_ стоит сразу за открывающей кавычкой. Обычные символы пропускаются
+            // по 16 байт, проверяются только escape-последовательности
+            const char *ScanString()
+            {
+                while (true)
+                {
+                    pos_ = detail::FindStringSpecial(pos_, end_);
+                    if (pos_ == end_)
+                    {
+                        return "String parsing error";
+                    }
+                    if (*pos_ == '"')
+                    {
+                        ++pos_;
+                        return nullptr;
+                    }
+                    if (*pos_ != '\\')
+                    {
+                        // Строковый литерал внутри JSON не может прерываться символами \r или \n
+                        return "Unexpected end of line";
+                    }
+                    if (const char *error = ScanEscape())
+                    {
+                        return error;
+                    }
+                }
+            }
+
+            // pos_ стоит на обратной косой черте. Последовательность, которую оборвал конец
+            // входа, - незакрытая строка, как и в DecodeString
+            const char *ScanEscape()
+            {
+                const auto available = static_cast<size_t>(end_ - pos_);
+                if (available < 2)
+                {
+                    pos_ = end_;
+                    return "String parsing error";
+                }
+                switch (pos_[1])
+                {
+                case '"':
+                case '\\':
+                case '/':
+                case 'b':
+                case 'f':
+                case 'n':
+                case 'r':
+                case 't':
+                    pos_ += 2;
+                    return nullptr;
+                case 'u':
+                    break;
+                default:
+                    return "Unrecognized escape sequence";
+                }
+                if (available < 6)
+                {
+                    pos_ = end_;
+                    return "String parsing error";
+                }
+                uint32_t code;
+                if (!ReadHex4(pos_ + 2, code))
+                {
+                    return "Invalid \\u escape sequence";
+                }
+                if (detail::IsLowSurrogate(code))
+                {
+                    return "Invalid surrogate pair";
+                }
+                if (!detail::IsHighSurrogate(code))
+                {
+                    pos_ += 6;
+                    return nullptr;
+                }
+                // Символ вне базовой плоскости: следом должна идти вторая половина пары
+                if (available < 12)
+                {
+                    pos_ = end_;
+                    return "String parsing error";
+                }
+                if (pos_[6] != '\\' || pos_[7] != 'u')
+                {
+                    return "Invalid surrogate pair";
+                }
+                uint32_t low;
+                if (!ReadHex4(pos_ + 8, low))
+                {
+                    return "Invalid \\u escape sequence";
+                }
+                if (!detail::IsLowSurrogate(low))
+                {
+                    return "Invalid surrogate pair";
+                }
+                pos_ += 12;
+                return nullptr;
+            }
+
+            template <bool (*is_run_char)(char)>
+            std::string_view ReadRun()
+            {
+                const char *begin = pos_++;
+                while (pos_ != end_ && is_run_char(*pos_))
+                {
+                    ++pos_;
+                }
+                return {begin, static_cast<size_t>(pos_ - begin)};
+            }
+
+            // Load отвергает и число, которое не помещается в double. Запись короче 200 символов
+            // с порядком не больше двух цифр лежит между 1e-299 и 1e299, поэтому обычные числа
+            // проверяются только по записи, без перевода
+            static const char *CheckNumber(std::string_view token)
+            {
+                static constexpr size_t kAlwaysInRangeSize = 200;
+                static constexpr size_t kAlwaysInRangeExponentDigits = 2;
+
+                bool is_int = true;
+                if (const char *error = detail::CheckNumber(token, is_int))
+                {
+                    return error;
+                }
+                if (token.size() < kAlwaysInRangeSize)
+                {
+                    if (is_int)
+                    {
+                        return nullptr;
+                    }
+                    // Порядок, если он есть, - последние цифры записи
+                    size_t pos = token.size();
+                    while (token[pos - 1] >= '0' && token[pos - 1] <= '9')
+                    {
+                        --pos;
+                    }
+                    const size_t exponent_digits = token.size() - pos;
+                    if (token[pos - 1] == '+' || token[pos - 1] == '-')
+                    {
+                        --pos;
+                    }
+                    if ((token[pos - 1] != 'e' && token[pos - 1] != 'E') || exponent_digits <= kAlwaysInRangeExponentDigits)
+                    {
+                        return nullptr;
+                    }
+                }
+                double value;
+                const char *end = token.data() + token.size();
+                const auto [ptr, ec] = std::from_chars(token.data(), end, value);
+                return ec == std::errc{} && ptr == end ? nullptr : "Failed to convert number";
+            }
+
+            // Стек вложенности по биту на уровень: 1 - массив, 0 - словарь
+            static constexpr size_t kInlineWords = 64;
+
+            void Push(bool is_array)
+            {
+                const size_t word = depth_ / 64;
+                if (word >= kInlineWords && heap_stack_.size() <= word - kInlineWords)
+                {
+                    // Глубже 4096 уровней стек продолжается в куче
+                    heap_stack_.push_back(0);
+                }
+                uint64_t &slot = word < kInlineWords ? inline_stack_[word] : heap_stack_[word - kInlineWords];
+                const uint64_t bit = uint64_t{1} << (depth_ % 64);
+                slot = is_array ? (slot | bit) : (slot & ~bit);
+                ++depth_;
+            }
+
+            bool IsArray() const
+            {
+                const size_t top = depth_ - 1;
+                const size_t word = top / 64;
+                const uint64_t value = word < kInlineWords ? inline_stack_[word] : heap_stack_[word - kInlineWords];
+                return (value >> (top % 64)) & 1;
+            }
+
+            const char *begin_;
+            const char *pos_;
+            const char *end_;
+            size_t max_depth_;
+            size_t depth_ = 0;
+            // Только что открыт контейнер, и элементов в нём ещё нет
+            bool first_ = false;
+            uint64_t inline_stack_[kInlineWords];
+            std::vector<uint64_t> heap_stack_;
+        };
+
+    } // namespace
+
+    bool ValidationResult::IsValid() const
+    {
+        return error == nullptr;
+    }
+
+    ValidationResult Validate(std::string_view input, const LoadOptions &options)
+    {
+        Validator validator(input, options.max_depth);
+        ValidationResult result;
+        result.error = validator.Run();
+        if (result.error == nullptr)
+        {
+            return result;
+        }
+        // Строка и столбец нужны только для ошибки, поэтому считаются после разбора
+        result.offset = validator.GetOffset();
+        const std::string_view prefix = input.substr(0, result.offset);
+        result.line = 1 + static_cast<size_t>(std::count(prefix.begin(), prefix.end(), '\n'));
+        const size_t line_start = prefix.rfind('\n');
+        result.column = 1 + (line_start == std::string_view::npos ? result.offset : result.offset - line_start - 1);
+        return result;
+    }
+
+} // namespace json
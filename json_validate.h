@@ -0,0 +1,33 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <string_view>
+
+namespace json
+{
+    // Итог проверки документа
+    struct ValidationResult
+    {
+        // Описание ошибки или nullptr, если документ корректен. Строка статическая
+        const char *error = nullptr;
+        // Байт, на котором найдена ошибка, считая от начала входа. Для оборванного
+        // документа - длина входа
+        size_t offset = 0;
+        // Строка и столбец того же байта, с единицы. Столбец считается в байтах
+        size_t line = 0;
+        size_t column = 0;
+
+        bool IsValid() const;
+    };
+
+    // Проверяет, что input - корректный JSON, не строя документ: по той же грамматике, что Load,
+    // с тем же ограничением вложенности LoadOptions::max_depth (остальные параметры не действуют).
+    // В отличие от Load, который не читает дальше корневого значения, после него допускаются
+    // только пробелы. Ошибки не бросаются, а возвращаются в результате.
+    // Память не выделяется, пока вложенность не превышает 4096; пробелы и строки
+    // просматриваются по 16 байт, где есть SSE2
+    ValidationResult Validate(std::string_view input, const LoadOptions &options = {});
+
+} // namespace json
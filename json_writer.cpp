@@ -0,0 +1,452 @@
+#include "json_writer.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iterator>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_WRITER_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        // Записи \u00XX для управляющих символов с кодами 0x00-0x1F
+        using ControlEscapes = std::array<std::array<char, 6>, 0x20>;
+
+        ControlEscapes MakeControlEscapes()
+        {
+            static constexpr char kHexDigits[] = "0123456789abcdef";
+            ControlEscapes escapes;
+            for (size_t code = 0; code < escapes.size(); ++code)
+            {
+                escapes[code] = {'\\', 'u', '0', '0', kHexDigits[code / 16], kHexDigits[code % 16]};
+            }
+            return escapes;
+        }
+
+        // Экранированная запись символа или пустая строка, если символ выводится как есть.
+        // Управляющие символы без короткой записи выводятся как \u00XX
+        std::string_view EscapeOf(char c)
+        {
+            switch (c)
+            {
+            case '"':
+                return "\\\""sv;
+            case '\\':
+                return "\\\\"sv;
+            case '\b':
+                return "\\b"sv;
+            case '\f':
+                return "\\f"sv;
+            case '\n':
+                return "\\n"sv;
+            case '\r':
+                return "\\r"sv;
+            case '\t':
+                return "\\t"sv;
+            default:
+                break;
+            }
+            const auto code = static_cast<unsigned char>(c);
+            if (code >= 0x20)
+            {
+                return {};
+            }
+            static const ControlEscapes escapes = MakeControlEscapes();
+            return {escapes[code].data(), escapes[code].size()};
+        }
+
+#ifdef JSON_WRITER_SSE2
+        int CountTrailingZeros(unsigned mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+#endif
+
+        // Первый символ, который нужно экранировать. SSE2 есть на любом x86-64,
+        // поэтому проверка по 16 байт не требует выбора реализации во время работы
+        const char *FindEscape(const char *pos, const char *end)
+        {
+#ifdef JSON_WRITER_SSE2
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i max_control = _mm_set1_epi8(0x1F);
+            while (end - pos >= 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+                // Байт не больше 0x1F без знака - тот, что не меняется от max с 0x1F
+                const __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(chunk, max_control), max_control);
+                const __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), control);
+                const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+                if (mask != 0)
+                {
+                    return pos + CountTrailingZeros(mask);
+                }
+                pos += 16;
+            }
+#endif
+            while (pos != end && EscapeOf(*pos).empty())
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // Порог, ниже которого поддерево выводится в одном потоке
+        constexpr size_t kMinParallelNodes = 16 * 1024;
+        // Контейнер с меньшим числом элементов не делится на диапазоны
+        constexpr size_t kMinParallelItems = 64;
+        constexpr size_t kMinRangeItems = 16;
+        constexpr size_t kRangesPerThread = 4;
+
+        // Спуститься глубже за большим контейнером не стоит: цепочка из одиночных
+        // вложенных контейнеров выводится в одном потоке
+        constexpr size_t kMaxParallelLevels = 16;
+
+        // Проверяет, что в поддереве не меньше limit узлов. Обход останавливается,
+        // как только узлов набралось достаточно (посещённые плюс ждущие в pending),
+        // поэтому проверка дешёвая при любом размере
+        bool HasNodes(const Node &node, size_t limit)
+        {
+            std::vector<const Node *> pending{&node};
+            while (!pending.empty())
+            {
+                const Node *current = pending.back();
+                pending.pop_back();
+                if (--limit == 0)
+                {
+                    return true;
+                }
+                if (current->IsArray())
+                {
+                    for (const Node &item : current->AsArray())
+                    {
+                        pending.push_back(&item);
+                        if (pending.size() >= limit)
+                        {
+                            return true;
+                        }
+                    }
+                }
+                else if (current->IsMap())
+                {
+                    for (const auto &[key, item] : current->AsMap())
+                    {
+                        pending.push_back(&item);
+                        if (pending.size() >= limit)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+    } // namespace
+
+    Writer::Writer()
+        : buffer_(&own_buffer_) {}
+
+    Writer::Writer(std::string &buffer)
+        : buffer_(&buffer) {}
+
+    void Writer::WriteNode(const Node &node)
+    {
+        if (WriteScalar(node))
+        {
+            return;
+        }
+        stack_.clear();
+        OpenContainer(node);
+        WriteFrames();
+    }
+
+    bool Writer::WriteScalar(const Node &node)
+    {
+        return node.Visit([this](const auto &value)
+                          {
+            using Value = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<Value, std::nullptr_t>)
+            {
+                WriteNull();
+            }
+            else if constexpr (std::is_same_v<Value, bool>)
+            {
+                WriteBool(value);
+            }
+            else if constexpr (std::is_same_v<Value, int> || std::is_same_v<Value, int64_t>)
+            {
+                WriteInt(value);
+            }
+            else if constexpr (std::is_same_v<Value, double>)
+            {
+                WriteDouble(value);
+            }
+            else if constexpr (std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+            {
+                WriteString(value);
+            }
+            else
+            {
+                return false;
+            }
+            return true; });
+    }
+
+    void Writer::OpenContainer(const Node &node)
+    {
+        if (node.IsArray())
+        {
+            const Array &array = node.AsArray();
+            buffer_->push_back('[');
+            stack_.push_back({&array, nullptr, 0, array.size(), true});
+        }
+        else
+        {
+            const Dict &dict = node.AsMap();
+            buffer_->append("{ "sv);
+            stack_.push_back({nullptr, &dict, 0, dict.size(), true});
+        }
+    }
+
+    void Writer::WriteFrames()
+    {
+        while (!stack_.empty())
+        {
+            Frame &frame = stack_.back();
+            if (frame.index == frame.last)
+            {
+                if (frame.close)
+                {
+                    if (frame.array != nullptr)
+                    {
+                        buffer_->push_back(']');
+                    }
+                    else
+                    {
+                        buffer_->append(" }"sv);
+                    }
+                }
+                stack_.pop_back();
+                continue;
+            }
+            const size_t i = frame.index++;
+            const Node *item;
+            if (frame.array != nullptr)
+            {
+                if (i > 0)
+                {
+                    buffer_->push_back(',');
+                }
+                item = &(*frame.array)[i];
+            }
+            else
+            {
+                if (i > 0)
+                {
+                    buffer_->append(" , "sv);
+                }
+                const auto &[key, value] = frame.dict->begin()[static_cast<std::ptrdiff_t>(i)];
+                WriteString(key);
+                buffer_->append(" : "sv);
+                item = &value;
+            }
+            // frame может стать недействительным, как только стек вырастет
+            if (!WriteScalar(*item))
+            {
+                OpenContainer(*item);
+            }
+        }
+    }
+
+    void Writer::WriteNode(const Node &node, size_t threads)
+    {
+        if (threads == 0)
+        {
+            threads = detail::GetDefaultThreadCount();
+        }
+        WriteNodeParallel(node, threads, 0);
+    }
+
+    void Writer::WriteNodeParallel(const Node &node, size_t threads, size_t levels)
+    {
+        if (threads == 1 || levels == kMaxParallelLevels || !HasNodes(node, kMinParallelNodes))
+        {
+            WriteNode(node);
+            return;
+        }
+        if (node.IsArray())
+        {
+            const Array &array = node.AsArray();
+            buffer_->push_back('[');
+            if (array.size() >= kMinParallelItems)
+            {
+                WriteItemsParallel(array, threads);
+            }
+            else
+            {
+                // Немного больших элементов: ищем, что распараллелить, уровнем ниже
+                for (size_t i = 0; i < array.size(); ++i)
+                {
+                    if (i > 0)
+                    {
+                        buffer_->push_back(',');
+                    }
+                    WriteNodeParallel(array[i], threads, levels + 1);
+                }
+            }
+            buffer_->push_back(']');
+        }
+        else
+        {
+            const Dict &dict = node.AsMap();
+            buffer_->append("{ "sv);
+            if (dict.size() >= kMinParallelItems)
+            {
+                WriteItemsParallel(dict, threads);
+            }
+            else
+            {
+                bool is_first = true;
+                for (const auto &[key, item] : dict)
+                {
+                    if (!is_first)
+                    {
+                        buffer_->append(" , "sv);
+                    }
+                    WriteString(key);
+                    buffer_->append(" : "sv);
+                    WriteNodeParallel(item, threads, levels + 1);
+                    is_first = false;
+                }
+            }
+            buffer_->append(" }"sv);
+        }
+    }
+
+    void Writer::WriteItems(const Array &array, size_t first, size_t last)
+    {
+        stack_.clear();
+        stack_.push_back({&array, nullptr, first, last, false});
+        WriteFrames();
+    }
+
+    void Writer::WriteItems(const Dict &dict, size_t first, size_t last)
+    {
+        stack_.clear();
+        stack_.push_back({nullptr, &dict, first, last, false});
+        WriteFrames();
+    }
+
+    template <typename Container>
+    void Writer::WriteItemsParallel(const Container &container, size_t threads)
+    {
+        const size_t count = container.size();
+        const size_t ranges = std::min(threads * kRangesPerThread, count / kMinRangeItems);
+        std::vector<std::string> parts(ranges);
+        detail::ParallelFor(ranges, threads, [&](size_t range)
+                            {
+                                Writer writer(parts[range]);
+                                writer.WriteItems(container, count * range / ranges, count * (range + 1) / ranges); });
+        size_t total = buffer_->size();
+        for (const std::string &part : parts)
+        {
+            total += part.size();
+        }
+        buffer_->reserve(total);
+        for (const std::string &part : parts)
+        {
+            buffer_->append(part);
+        }
+    }
+
+    void Writer::WriteNull()
+    {
+        buffer_->append("null"sv);
+    }
+
+    void Writer::WriteBool(bool value)
+    {
+        buffer_->append(value ? "true"sv : "false"sv);
+    }
+
+    void Writer::WriteInt(int64_t value)
+    {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer_->append(digits, result.ptr);
+    }
+
+    // Кратчайшая запись, из которой читается то же самое значение
+    void Writer::WriteDouble(double value)
+    {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer_->append(digits, result.ptr);
+    }
+
+    void Writer::WriteString(std::string_view value)
+    {
+        buffer_->push_back('"');
+        WriteEscaped(value);
+        buffer_->push_back('"');
+    }
+
+    void Writer::WriteEscaped(std::string_view value)
+    {
+        const char *pos = value.data();
+        const char *end = value.data() + value.size();
+        while (pos != end)
+        {
+            const char *special = FindEscape(pos, end);
+            buffer_->append(pos, special);
+            if (special == end)
+            {
+                break;
+            }
+            buffer_->append(EscapeOf(*special));
+            pos = special + 1;
+        }
+    }
+
+    void Writer::WriteRaw(std::string_view text)
+    {
+        buffer_->append(text);
+    }
+
+    std::string_view Writer::GetData() const
+    {
+        return *buffer_;
+    }
+
+    std::string Writer::TakeData()
+    {
+        std::string data = move(*buffer_);
+        buffer_->clear();
+        return data;
+    }
+
+    void Writer::Clear()
+    {
+        buffer_->clear();
+    }
+
+} // namespace json
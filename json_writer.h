@@ -0,0 +1,84 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+    // Сериализатор, который дописывает текст в непрерывный буфер, а не в std::ostream.
+    // Участки строк без экранируемых символов копируются целиком, числа форматируются
+    // через std::to_chars. Формат вывода совпадает с Print
+    class Writer
+    {
+    public:
+        // Текст накапливается во внутреннем буфере
+        Writer();
+        // Текст дописывается в конец buffer. Если очищать буфер между документами,
+        // его память переиспользуется и повторная сериализация обходится без выделений
+        explicit Writer(std::string &buffer);
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        void WriteNode(const Node &node);
+        // Выводит узел на threads потоках (0 - по числу ядер). Дочерние значения большого
+        // массива или словаря делятся на диапазоны, каждый выводится в собственный буфер,
+        // и буферы склеиваются по порядку, так что текст совпадает с WriteNode(node).
+        // Поддеревья меньше порога выводятся в одном потоке
+        void WriteNode(const Node &node, size_t threads);
+        void WriteNull();
+        void WriteBool(bool value);
+        void WriteInt(int64_t value);
+        void WriteDouble(double value);
+        // Строка в кавычках с экранированием
+        void WriteString(std::string_view value);
+        // Экранирует строку без кавычек: кавычку, обратную косую черту и все символы
+        // с кодами меньше 0x20, так что результат всегда читается обратно как JSON
+        void WriteEscaped(std::string_view value);
+        // Дописывает текст как есть
+        void WriteRaw(std::string_view text);
+
+        std::string_view GetData() const;
+        // Забирает накопленный текст, буфер остаётся пустым
+        std::string TakeData();
+        void Clear();
+
+    private:
+        // Контейнер, который выводится сейчас. Вложенность хранится в явном стеке,
+        // поэтому глубина документа не ограничена размером стека вызовов
+        struct Frame
+        {
+            // Задан ровно один из указателей
+            const Array *array;
+            const Dict *dict;
+            size_t index;
+            size_t last;
+            // Закрывать ли скобку после последнего элемента
+            bool close;
+        };
+
+        // Выводит значение, если это не контейнер; для контейнера возвращает false
+        bool WriteScalar(const Node &node);
+        void OpenContainer(const Node &node);
+        // Выводит элементы из стека, пока он не опустеет
+        void WriteFrames();
+        // Элементы с номерами [first, last) вместе с разделителями перед ними
+        void WriteItems(const Array &array, size_t first, size_t last);
+        void WriteItems(const Dict &dict, size_t first, size_t last);
+        // levels - на сколько уровней уже спустились в поисках большого контейнера
+        void WriteNodeParallel(const Node &node, size_t threads, size_t levels);
+        // Выводит дочерние значения контейнера диапазонами на нескольких потоках
+        template <typename Container>
+        void WriteItemsParallel(const Container &container, size_t threads);
+
+        std::string own_buffer_;
+        std::string *buffer_;
+        // Память стека переиспользуется между вызовами
+        std::vector<Frame> stack_;
+    };
+
+} // namespace json
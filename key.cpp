@@ -0,0 +1,172 @@
+#include "key.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace json
+{
+    Key::Key() noexcept
+        : external_(nullptr) {}
+
+    Key::Key(std::string_view value)
+        : Key()
+    {
+        Assign(value);
+    }
+
+    Key::Key(const std::string &value)
+        : Key(std::string_view(value)) {}
+
+    Key::Key(const char *value)
+        : Key(std::string_view(value)) {}
+
+    Key::Key(const Key &other)
+        : Key()
+    {
+        Assign(other);
+    }
+
+    Key::Key(Key &&other) noexcept
+    {
+        // Все варианты хранения тривиально копируются, поэтому достаточно скопировать представление
+        std::memcpy(static_cast<void *>(this), &other, sizeof(Key));
+        other.kind_ = Kind::Inline;
+        other.size_ = 0;
+    }
+
+    Key &Key::operator=(const Key &rhs)
+    {
+        if (this != &rhs)
+        {
+            Key copy(rhs);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    Key &Key::operator=(Key &&rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            Release();
+            std::memcpy(static_cast<void *>(this), &rhs, sizeof(Key));
+            rhs.kind_ = Kind::Inline;
+            rhs.size_ = 0;
+        }
+        return *this;
+    }
+
+    Key::~Key()
+    {
+        Release();
+    }
+
+    void Key::Assign(std::string_view value)
+    {
+        if (value.size() > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::length_error("Key is too long");
+        }
+        if (value.size() <= kInlineCapacity)
+        {
+            std::memcpy(inline_, value.data(), value.size());
+            kind_ = Kind::Inline;
+        }
+        else
+        {
+            char *chars = new char[value.size()];
+            std::memcpy(chars, value.data(), value.size());
+            external_ = chars;
+            kind_ = Kind::Heap;
+        }
+        size_ = static_cast<uint32_t>(value.size());
+    }
+
+    void Key::Release() noexcept
+    {
+        if (kind_ == Kind::Heap)
+        {
+            delete[] external_;
+        }
+        kind_ = Kind::Inline;
+        size_ = 0;
+    }
+
+    const char *Key::data() const noexcept
+    {
+        return kind_ == Kind::Inline ? inline_ : external_;
+    }
+
+    size_t Key::size() const noexcept
+    {
+        return size_;
+    }
+
+    bool Key::empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    Key::operator std::string_view() const noexcept
+    {
+        return {data(), size_};
+    }
+
+    bool Key::IsInterned() const noexcept
+    {
+        return kind_ == Kind::Interned;
+    }
+
+    size_t Key::GetHeapBytes() const noexcept
+    {
+        return kind_ == Kind::Heap ? size_ : 0;
+    }
+
+    bool operator==(const Key &lhs, const Key &rhs) noexcept
+    {
+        if (lhs.size_ != rhs.size_)
+        {
+            return false;
+        }
+        // Одинаковые ключи одной таблицы ссылаются на одну строку, и символы можно не сравнивать
+        if (lhs.kind_ == Key::Kind::Interned && rhs.kind_ == Key::Kind::Interned && lhs.external_ == rhs.external_)
+        {
+            return true;
+        }
+        return std::string_view(lhs) == std::string_view(rhs);
+    }
+
+    bool operator<(const Key &lhs, const Key &rhs) noexcept
+    {
+        return std::string_view(lhs) < std::string_view(rhs);
+    }
+
+    Key KeyTable::Intern(std::string_view key)
+    {
+        if (key.size() > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::length_error("Key is too long");
+        }
+        auto it = keys_.find(key);
+        if (it == keys_.end())
+        {
+            char *chars = static_cast<char *>(chars_.allocate(key.size() == 0 ? 1 : key.size(), 1));
+            std::memcpy(chars, key.data(), key.size());
+            it = keys_.emplace(chars, key.size()).first;
+        }
+        Key result;
+        result.external_ = it->data();
+        result.size_ = static_cast<uint32_t>(it->size());
+        result.kind_ = Key::Kind::Interned;
+        return result;
+    }
+
+    size_t KeyTable::size() const
+    {
+        return keys_.size();
+    }
+
+} // namespace json
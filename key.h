@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+
+namespace json
+{
+    // Ключ словаря. Короткий ключ хранится прямо в объекте, длинный - в отдельном блоке
+    // в куче. Ключ из KeyTable только ссылается на строку таблицы: одинаковые ключи документа
+    // не занимают лишней памяти, а сравниваются сравнением указателей.
+    // Копия ключа из таблицы владеет собственной строкой и не зависит от документа
+    class Key
+    {
+    public:
+        static constexpr size_t kInlineCapacity = 16;
+
+        Key() noexcept;
+        Key(std::string_view value);
+        Key(const std::string &value);
+        Key(const char *value);
+
+        Key(const Key &other);
+        Key(Key &&other) noexcept;
+        Key &operator=(const Key &rhs);
+        Key &operator=(Key &&rhs) noexcept;
+        ~Key();
+
+        const char *data() const noexcept;
+        size_t size() const noexcept;
+        bool empty() const noexcept;
+        operator std::string_view() const noexcept;
+
+        bool IsInterned() const noexcept;
+        // Память в куче, которую занимает сам ключ
+        size_t GetHeapBytes() const noexcept;
+
+        friend bool operator==(const Key &lhs, const Key &rhs) noexcept;
+        friend bool operator<(const Key &lhs, const Key &rhs) noexcept;
+
+    private:
+        friend class KeyTable;
+
+        enum class Kind : uint8_t
+        {
+            Inline,
+            Heap,
+            Interned,
+        };
+
+        void Assign(std::string_view value);
+        void Release() noexcept;
+
+        union
+        {
+            const char *external_;
+            char inline_[kInlineCapacity];
+        };
+        uint32_t size_ = 0;
+        Kind kind_ = Kind::Inline;
+    };
+
+    inline bool operator!=(const Key &lhs, const Key &rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+    // Сравнение со строками любого вида без создания временного Key. Ключ тоже принимается
+    // параметром шаблона: иначе неявное преобразование в Key сделало бы неоднозначным
+    // сравнение, например, std::string со std::string_view
+    template <typename KeyType, typename String>
+    using EnableIfKeyComparable = std::enable_if_t<std::is_same_v<KeyType, Key> && std::is_convertible_v<const String &, std::string_view> && !std::is_same_v<String, Key>, bool>;
+
+    template <typename KeyType, typename String, EnableIfKeyComparable<KeyType, String> = true>
+    bool operator==(const KeyType &lhs, const String &rhs) noexcept
+    {
+        return std::string_view(lhs) == std::string_view(rhs);
+    }
+    template <typename String, typename KeyType, EnableIfKeyComparable<KeyType, String> = true>
+    bool operator==(const String &lhs, const KeyType &rhs) noexcept
+    {
+        return rhs == lhs;
+    }
+    template <typename KeyType, typename String, EnableIfKeyComparable<KeyType, String> = true>
+    bool operator!=(const KeyType &lhs, const String &rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+    template <typename String, typename KeyType, EnableIfKeyComparable<KeyType, String> = true>
+    bool operator!=(const String &lhs, const KeyType &rhs) noexcept
+    {
+        return !(rhs == lhs);
+    }
+    template <typename KeyType, typename String, EnableIfKeyComparable<KeyType, String> = true>
+    bool operator<(const KeyType &lhs, const String &rhs) noexcept
+    {
+        return std::string_view(lhs) < std::string_view(rhs);
+    }
+
+    // Таблица ключей документа: каждая различная строка хранится в ней один раз.
+    // Не потокобезопасна; ключи действительны, пока жива таблица
+    class KeyTable
+    {
+    public:
+        KeyTable() = default;
+        KeyTable(const KeyTable &) = delete;
+        KeyTable &operator=(const KeyTable &) = delete;
+
+        Key Intern(std::string_view key);
+        // Число различных ключей
+        size_t size() const;
+
+    private:
+        std::pmr::monotonic_buffer_resource chars_;
+        std::unordered_set<std::string_view> keys_;
+    };
+
+} // namespace json
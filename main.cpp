@@ -1,12 +1,124 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
 #include <sstream>
 #include <string_view>
+#include <type_traits>
 #include "json.h"
+#include "json_binary.h"
+#include "json_builder.h"
+#include "json_lazy.h"
+#include "json_lines.h"
+#include "json_path.h"
+#include "json_sax.h"
+#include "json_snapshot.h"
+#include "json_stats.h"
+#include "json_validate.h"
+#include "json_writer.h"
+#include "structural_index.h"
 
 using namespace json;
 using namespace std::literals;
 
+// Считаем выделения памяти, чтобы бенчмарк мог их показать. Счётчик атомарный:
+// разбор JSON Lines выделяет память из нескольких потоков
+static std::atomic<size_t> allocation_count{0};
+
+// Все замены new и delete проходят через эту пару. CountedFree не встраивается, поэтому
+// компилятор не видит free рядом с operator new и не предупреждает о несовпадающих new и delete
+#if defined(__GNUC__)
+#define JSON_TEST_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define JSON_TEST_NOINLINE __declspec(noinline)
+#else
+#define JSON_TEST_NOINLINE
+#endif
+
+static void *CountedAllocate(size_t size, size_t alignment) noexcept
+{
+    ++allocation_count;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        return std::malloc(size);
+    }
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+JSON_TEST_NOINLINE static void CountedFree(void *ptr, size_t alignment) noexcept
+{
+#ifdef _MSC_VER
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        _aligned_free(ptr);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(ptr);
+}
+
+void *operator new(size_t size)
+{
+    if (void *ptr = CountedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return CountedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    CountedFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    CountedFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    CountedFree(ptr, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+// Через выровненные версии выделяет память std::pmr::new_delete_resource
+void *operator new(size_t size, std::align_val_t align)
+{
+    if (void *ptr = CountedAllocate(size, static_cast<size_t>(align)))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr, std::align_val_t align) noexcept
+{
+    CountedFree(ptr, static_cast<size_t>(align));
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t align) noexcept
+{
+    CountedFree(ptr, static_cast<size_t>(align));
+}
+
 namespace
 {
 
@@ -14,10 +126,18 @@ namespace
     // Можете воспользоваться ими, чтобы протестировать свой код.
     // Раскомментируйте их по мере работы.
 
+    // Разбирает строку через поток и через буфер и проверяет, что оба пути дают одно и то же
     json::Document LoadJSON(const std::string &s)
     {
         std::istringstream strm(s);
-        return json::Load(strm);
+        json::Document from_stream = json::Load(strm);
+        json::Document from_buffer = json::Load(std::string_view(s));
+        assert(from_stream == from_buffer);
+        LoadOptions indexed;
+        indexed.use_structural_index = true;
+        assert(json::Load(std::string_view(s), indexed) == from_buffer);
+        assert(json::Validate(s).IsValid());
+        return from_buffer;
     }
 
     std::string Print(const Node &node)
@@ -29,9 +149,33 @@ namespace
 
     void MustFailToLoad(const std::string &s)
     {
+        assert(!json::Validate(s).IsValid());
+        try
+        {
+            json::Load(std::string_view(s));
+            std::cerr << "ParsingError exception is expected on '"sv << s << "'"sv << std::endl;
+            assert(false);
+        }
+        catch (const json::ParsingError &)
+        {
+            // ok
+        }
+        try
+        {
+            LoadOptions indexed;
+            indexed.use_structural_index = true;
+            json::Load(std::string_view(s), indexed);
+            std::cerr << "ParsingError exception is expected on '"sv << s << "'"sv << std::endl;
+            assert(false);
+        }
+        catch (const json::ParsingError &)
+        {
+            // ok
+        }
         try
         {
-            LoadJSON(s);
+            std::istringstream strm(s);
+            json::Load(strm);
             std::cerr << "ParsingError exception is expected on '"sv << s << "'"sv << std::endl;
             assert(false);
         }
@@ -138,6 +282,34 @@ namespace
         assert(LoadJSON(" \t\r\n\n\r 0.0 \t\r\n\n\r ").GetRoot() == Node{0.0});
     }
 
+    void TestLargeNumbers()
+    {
+        const Node max_int = LoadJSON("2147483647"s).GetRoot();
+        assert(max_int.IsInt() && max_int.AsInt() == 2147483647);
+
+        // Целые за пределами int больше не превращаются в double
+        const Node big = LoadJSON("9007199254740993"s).GetRoot();
+        assert(!big.IsInt());
+        assert(big.IsInt64());
+        assert(big.IsDouble());
+        assert(!big.IsPureDouble());
+        assert(big.AsInt64() == 9007199254740993);
+        assert(big.GetType() == Node::Type::Int64);
+        assert(Print(big) == "9007199254740993"s);
+        assert(LoadJSON("-2147483649"s).GetRoot().AsInt64() == -2147483649LL);
+        assert(LoadJSON("[-9223372036854775808]"s).GetRoot().AsArray().at(0).AsInt64() == std::numeric_limits<int64_t>::min());
+        assert(Node{int64_t{42}}.IsInt());
+        assert(Node{int64_t{42}} == Node{42});
+
+        // Переполнение int64_t даёт double
+        const Node huge = LoadJSON("99999999999999999999"s).GetRoot();
+        assert(huge.IsPureDouble());
+        assert(huge.AsDouble() == 1e20);
+        MustFailToLoad("1e400"s);
+        MustFailToLoad("-"s);
+        MustFailToLoad("1."s);
+    }
+
     void TestStrings()
     {
         Node str_node{"Hello, \"everybody\""s};
@@ -155,6 +327,18 @@ namespace
         assert(Print(LoadJSON(escape_chars).GetRoot()) == "\"\\r\\n\\t\\\"\\\\\""s);
         // Пробелы, табуляции и символы перевода строки между токенами JSON файла игнорируются
         assert(LoadJSON("\t\r\n\n\r \"Hello\" \t\r\n\n\r ").GetRoot() == Node{"Hello"s});
+
+        // \uXXXX записывается в UTF-8, символ вне базовой плоскости - суррогатной парой
+        assert(LoadJSON(R"("\b\f\/ \u0041\u00e9\u20AC\ud83d\ude00")"s).GetRoot().AsString() == "\b\f/ A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"s);
+        // Длинная строка без escape-последовательностей проходит быстрым путём целиком
+        const std::string long_str(1'000, 'x');
+        assert(LoadJSON("\""s + long_str + "\""s).GetRoot().AsString() == long_str);
+        assert(LoadJSON("\""s + long_str + "\\u0078\""s).GetRoot().AsString() == long_str + "x"s);
+        MustFailToLoad(R"("\u12G4")"s);
+        MustFailToLoad(R"("\ud83d")"s);
+        MustFailToLoad(R"("\ud83d\u0041")"s);
+        MustFailToLoad(R"("\ude00")"s);
+        MustFailToLoad(R"("\x")"s);
     }
 
     void TestBool()
@@ -231,6 +415,27 @@ namespace
         MustFailToLoad("fals"s);
         MustFailToLoad("nul"s);
 
+        // Запятая стоит только между элементами
+        MustFailToLoad("[,1]"s);
+        MustFailToLoad("[1,,2]"s);
+        MustFailToLoad("[1,]"s);
+        MustFailToLoad("[1 2]"s);
+        MustFailToLoad("[,]"s);
+        MustFailToLoad(R"({,"a":1})"s);
+        MustFailToLoad(R"({"a":1,,"b":2})"s);
+        MustFailToLoad(R"({"a":1,})"s);
+        MustFailToLoad(R"({"a":1 "b":2})"s);
+        MustFailToLoad(R"([{"a":[1]}{"b":2}])"s);
+
+        // Число или литерал внутри контейнера кончается пробелом или структурным символом
+        MustFailToLoad("[1x]"s);
+        MustFailToLoad(R"({"a":1x})"s);
+        MustFailToLoad("[true#]"s);
+        MustFailToLoad("[1.5e3@, 2]"s);
+        // Вертикальная табуляция и перевод страницы - пробелы на обоих путях разбора
+        assert(LoadJSON("[1,\v2]"s).GetRoot() == Node(Array{1, 2}));
+        assert(LoadJSON("{\f\"a\"\v:\f1\v}"s).GetRoot() == Node(Dict{{"a"s, 1}}));
+
         Node dbl_node{3.5};
         MustThrowLogicError([&dbl_node]
                             { dbl_node.AsInt(); });
@@ -248,30 +453,2072 @@ namespace
                             { array_node.AsBool(); });
     }
 
-    void Benchmark()
+    // Временный файл, который удаляется вместе с объектом
+    class TempFile
     {
-        const auto start = std::chrono::steady_clock::now();
-        Array arr;
-        arr.reserve(1'000);
-        for (int i = 0; i < 1'000; ++i)
+    public:
+        explicit TempFile(const std::string &content)
+            : path_(std::filesystem::temp_directory_path() / "yandex_json_test.json")
         {
-            arr.emplace_back(Dict{
-                {"int"s, 42},
-                {"double"s, 42.1},
-                {"null"s, nullptr},
-                {"string"s, "hello"s},
-                {"array"s, Array{1, 2, 3}},
-                {"bool"s, true},
-                {"map"s, Dict{{"key"s, "value"s}}},
-            });
+            std::ofstream out(path_, std::ios::binary);
+            out << content;
         }
-        std::stringstream strm;
-        json::Print(Document{arr}, strm);
-        const auto doc = json::Load(strm);
-        assert(doc.GetRoot() == arr);
-        const auto duration = std::chrono::steady_clock::now() - start;
-        std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << "ms"sv
-                  << std::endl;
+
+        ~TempFile()
+        {
+            std::filesystem::remove(path_);
+        }
+
+        std::string GetPath() const
+        {
+            return path_.string();
+        }
+
+    private:
+        std::filesystem::path path_;
+    };
+
+    void TestLoadFile()
+    {
+        const TempFile file{"{ \"key\": [\"plain\", \"esc\\\"aped\"], \"num\": 42 }"s};
+        const Node expected{Dict{{"key"s, Array{"plain"s, "esc\"aped"s}}, {"num"s, 42}}};
+
+        const Document copied = LoadFile(file.GetPath());
+        assert(copied.GetRoot() == expected);
+        assert(copied.GetRoot().AsMap().at("key"s).AsArray().at(0).AsString() == "plain"s);
+
+        LoadOptions options;
+        options.borrow_strings = true;
+        const Document borrowed = LoadFile(file.GetPath(), options);
+        assert(borrowed == copied);
+        const Array &arr = borrowed.GetRoot().AsMap().at("key"s).AsArray();
+        // Строка без escape-последовательностей ссылается на отображение файла
+        assert(arr.at(0).IsString());
+        assert(arr.at(0).AsStringView() == "plain"sv);
+        MustThrowLogicError([&arr]
+                            { arr.at(0).AsString(); });
+        // Строку с escape-последовательностью пришлось раскодировать в собственный буфер
+        assert(arr.at(1).AsString() == "esc\"aped"s);
+        assert(Print(borrowed.GetRoot()) == Print(copied.GetRoot()));
+
+        // Копия документа продлевает жизнь отображению
+        const Document copy = borrowed;
+        assert(copy.GetRoot().AsMap().at("key"s).AsArray().at(0).AsStringView() == "plain"sv);
+
+        try
+        {
+            LoadFile(file.GetPath() + ".missing"s);
+            assert(false);
+        }
+        catch (const std::runtime_error &)
+        {
+            // ok
+        }
+    }
+
+    void TestArena()
+    {
+        const std::string text = "[{\"a\": [1, 2.5, \"long string that does not fit in SSO\"]}, {\"b\": {\"c\": null}}, true]"s;
+        const Document heap = Load(text);
+
+        LoadOptions options;
+        options.use_arena = true;
+        Node copy;
+        {
+            const Document arena = Load(text, options);
+            assert(arena == heap);
+            assert(arena.GetRoot().AsArray().at(0).AsMap().at("a"s).AsArray().at(2).AsString() == "long string that does not fit in SSO"s);
+            assert(Print(arena.GetRoot()) == Print(heap.GetRoot()));
+            // Копия узла не зависит от арены документа
+            copy = arena.GetRoot();
+        }
+        assert(copy == heap.GetRoot());
+
+        // Присваивание заменяет арену только после того, как разрушены старые узлы
+        Document doc = Load(text, options);
+        doc = Load("[1, [2, 3]]"s, options);
+        assert((doc.GetRoot() == Node{Array{1, Array{2, 3}}}));
+        doc = heap;
+        assert(doc == heap);
+    }
+
+    void TestDict()
+    {
+        // Повторяющийся ключ: как и раньше, остаётся первое значение
+        const Document dup_doc = LoadJSON("{\"b\": 1, \"a\": 2, \"b\": 3}"s);
+        const Dict &dup = dup_doc.GetRoot().AsMap();
+        assert(dup.size() == 2);
+        assert(dup.at("b"sv).AsInt() == 1);
+        // Обход в порядке возрастания ключей
+        assert(dup.begin()->first == "a"s);
+
+        // Большой словарь ищет ключи через хеш-индекс
+        std::string text = "{"s;
+        Dict::Entries entries;
+        for (int i = 0; i < 100; ++i)
+        {
+            const std::string key = "key"s + std::to_string(i);
+            text += (i == 0 ? "\""s : ", \""s) + key + "\": "s + std::to_string(i);
+            entries.emplace_back(key, i);
+        }
+        text += "}"s;
+        const Dict expected(std::move(entries));
+        const Document big_doc = LoadJSON(text);
+        const Dict &big = big_doc.GetRoot().AsMap();
+        assert(big == expected);
+        for (int i = 0; i < 100; ++i)
+        {
+            assert(big.at("key"s + std::to_string(i)).AsInt() == i);
+        }
+        assert(big.count("key100"sv) == 0);
+        assert(big.find("missing"sv) == big.end());
+        try
+        {
+            big.at("missing"sv);
+            assert(false);
+        }
+        catch (const std::out_of_range &)
+        {
+            // ok
+        }
+        assert(std::is_sorted(big.begin(), big.end(), [](const auto &lhs, const auto &rhs)
+                              { return lhs.first < rhs.first; }));
+
+        Dict dict;
+        for (int i = 99; i >= 0; --i)
+        {
+            assert(dict.insert({"key"s + std::to_string(i), i}).second);
+        }
+        assert(!dict.emplace("key5"s, 42).second);
+        assert(dict.at("key5"sv).AsInt() == 5);
+        assert(dict == big);
+        assert(LoadJSON(Print(Node{dict})).GetRoot().AsMap() == dict);
+
+        // Вставки и удаления вперемешку поддерживают индекс без перестройки
+        unsigned seed = 7;
+        std::map<std::string, int> model;
+        Dict mixed;
+        for (int step = 0; step < 20'000; ++step)
+        {
+            seed = seed * 1103515245 + 12345;
+            const std::string key = "k"s + std::to_string((seed >> 16) % 500);
+            if ((seed >> 8) % 3 == 0)
+            {
+                assert(mixed.erase(key) == model.erase(key));
+            }
+            else
+            {
+                mixed[key] = step;
+                model[key] = step;
+            }
+            if (step % 97 == 0)
+            {
+                assert(mixed.size() == model.size());
+                for (const auto &[model_key, value] : model)
+                {
+                    assert(mixed.at(model_key).AsInt() == value);
+                }
+                assert(mixed.count("k500"sv) == 0);
+            }
+        }
+        while (!model.empty())
+        {
+            assert(mixed.erase(model.begin()->first) == 1);
+            model.erase(model.begin());
+            for (const auto &[model_key, value] : model)
+            {
+                assert(mixed.at(model_key).AsInt() == value);
+            }
+        }
+        assert(mixed.empty());
+    }
+
+    void TestCompactNode()
+    {
+        static_assert(sizeof(Node) == 16);
+
+        assert(Node{"text"}.AsString() == "text"s);
+        assert(Node{1}.GetType() == Node::Type::Int);
+        assert(Node{Dict{}}.GetType() == Node::Type::Dict);
+
+        // Копирование и перемещение не теряют вынесенные значения
+        Node original{Array{"long string that does not fit in SSO"s, Dict{{"key"s, Array{1, 2}}}}};
+        Node copy = original;
+        Node moved = std::move(copy);
+        assert(copy.IsNull());
+        assert(moved == original);
+        moved = original.AsArray().at(0);
+        assert(moved.AsString() == "long string that does not fit in SSO"s);
+        moved = moved;
+        assert(moved.IsString());
+
+        // Узел из string_view владеет копией строки, заимствует только Node::Borrow
+        std::string source = "view of a temporary string, longer than SSO"s;
+        const Node owned{std::string_view(source)};
+        const Node borrowed = Node::Borrow(source);
+        assert(owned.GetType() == Node::Type::String);
+        assert(borrowed.GetType() == Node::Type::BorrowedString);
+        assert(owned == borrowed);
+        source.assign(source.size(), 'x');
+        assert(owned.AsString() == "view of a temporary string, longer than SSO"s);
+        assert(borrowed.AsStringView() == source);
+
+        std::string types;
+        const Document all_types = LoadJSON("[null, 1, 2.5, \"s\", true, [], {}]"s);
+        for (const Node &node : all_types.GetRoot().AsArray())
+        {
+            node.Visit([&types](const auto &value)
+                       {
+                using Value = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<Value, std::nullptr_t>)
+                    types += 'n';
+                else if constexpr (std::is_same_v<Value, int>)
+                    types += 'i';
+                else if constexpr (std::is_same_v<Value, double>)
+                    types += 'd';
+                else if constexpr (std::is_same_v<Value, std::string>)
+                    types += 's';
+                else if constexpr (std::is_same_v<Value, bool>)
+                    types += 'b';
+                else if constexpr (std::is_same_v<Value, Array>)
+                    types += 'a';
+                else if constexpr (std::is_same_v<Value, Dict>)
+                    types += 'm'; });
+        }
+        assert(types == "nidsbam"s);
+
+        const Document doc = LoadJSON("[1, 2, {\"a\": true}]"s);
+        const MemoryUsage usage = doc.GetMemoryUsage();
+        // Корень, три элемента массива и значение в словаре
+        assert(usage.nodes == 5);
+        assert(usage.node_bytes >= 5 * sizeof(Node));
+        assert(usage.GetTotalBytes() > usage.node_bytes);
+    }
+
+    // Посимвольная модель первого прохода, с которой сверяются SIMD-реализации
+    std::vector<uint32_t> BuildStructuralIndexNaive(std::string_view input)
+    {
+        auto is_structural = [](char c)
+        { return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ','; };
+        auto is_scalar = [&](char c)
+        { return !is_structural(c) && c != ' ' && c != '\t' && c != '\n' && c != '\v' && c != '\f' && c != '\r' && c != '"'; };
+
+        std::vector<uint32_t> positions;
+        bool in_string = false;
+        bool escaped = false;
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            const char c = input[i];
+            const bool is_quote = c == '"' && !escaped;
+            escaped = !escaped && c == '\\';
+            if (in_string)
+            {
+                in_string = !is_quote;
+                continue;
+            }
+            if (is_quote)
+            {
+                in_string = true;
+                positions.push_back(static_cast<uint32_t>(i));
+            }
+            else if (is_structural(c) || (is_scalar(c) && (i == 0 || !is_scalar(input[i - 1]))))
+            {
+                positions.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        if (in_string)
+        {
+            throw ParsingError("String parsing error");
+        }
+        return positions;
+    }
+
+    void TestStructuralIndex()
+    {
+        const std::vector<uint32_t> expected{0, 1, 7, 9, 10, 11, 13, 15, 17, 21, 22};
+        assert(BuildStructuralIndex(R"({"a\"b": [1, 22, true]})"sv) == expected);
+
+        std::vector<ScanBackend> backends{ScanBackend::Scalar};
+        if (GetScanBackend() != ScanBackend::Scalar)
+        {
+            backends.push_back(ScanBackend::Sse2);
+        }
+        if (GetScanBackend() == ScanBackend::Avx2)
+        {
+            backends.push_back(ScanBackend::Avx2);
+        }
+
+        // Случайные входы с длинными цепочками обратных косых черт и кавычками на границах блоков
+        const std::string alphabet = "{}[]:,\"\"\\\\\\ \n\tab1-\v\f\b\x0e"s;
+        unsigned seed = 42;
+        for (int round = 0; round < 2'000; ++round)
+        {
+            std::string input;
+            const size_t size = seed % 300;
+            for (size_t i = 0; i < size; ++i)
+            {
+                seed = seed * 1103515245 + 12345;
+                input += alphabet[(seed >> 16) % alphabet.size()];
+            }
+            bool naive_failed = false;
+            std::vector<uint32_t> naive;
+            try
+            {
+                naive = BuildStructuralIndexNaive(input);
+            }
+            catch (const ParsingError &)
+            {
+                naive_failed = true;
+            }
+            for (ScanBackend backend : backends)
+            {
+                try
+                {
+                    assert(BuildStructuralIndex(input, backend) == naive);
+                    assert(!naive_failed);
+                }
+                catch (const ParsingError &)
+                {
+                    assert(naive_failed);
+                }
+            }
+        }
+    }
+
+    // Записывает события разбора в строку, чтобы их было удобно сравнивать
+    class RecordingHandler : public Handler
+    {
+    public:
+        void OnNull() override
+        {
+            events_ += "null "s;
+        }
+        void OnBool(bool value) override
+        {
+            events_ += value ? "true "s : "false "s;
+        }
+        void OnInt(int64_t value) override
+        {
+            events_ += "i:"s + std::to_string(value) + " "s;
+        }
+        void OnDouble(double value) override
+        {
+            events_ += "d:"s + std::to_string(value) + " "s;
+        }
+        void OnString(std::string_view value) override
+        {
+            events_ += "s:"s + std::string(value) + " "s;
+        }
+        void OnKey(std::string_view key) override
+        {
+            events_ += "k:"s + std::string(key) + " "s;
+        }
+        void OnStartArray() override
+        {
+            events_ += "[ "s;
+        }
+        void OnEndArray() override
+        {
+            events_ += "] "s;
+        }
+        void OnStartObject() override
+        {
+            events_ += "{ "s;
+        }
+        void OnEndObject() override
+        {
+            events_ += "} "s;
+        }
+
+        const std::string &GetEvents() const
+        {
+            return events_;
+        }
+
+    private:
+        std::string events_;
+    };
+
+    // Подаёт текст парсеру кусками по chunk_size байт
+    std::string ParseInChunks(std::string_view text, size_t chunk_size)
+    {
+        RecordingHandler handler;
+        SaxParser parser(handler);
+        for (size_t pos = 0; pos < text.size(); pos += chunk_size)
+        {
+            parser.Feed(text.substr(pos, chunk_size));
+        }
+        parser.Finish();
+        assert(parser.IsDone());
+        return handler.GetEvents();
+    }
+
+    void TestSax()
+    {
+        const std::string text = R"( {"name": "esc\"aped\\", "list": [1, -2.5e1, true, false, null, []], "nested": {"empty": {}}, "big": 9007199254740993} )"s;
+        RecordingHandler handler;
+        Parse(text, handler);
+        const std::string expected = "{ k:name s:esc\"aped\\ k:list [ i:1 d:-25.000000 true false null [ ] ] k:nested { k:empty { } } k:big i:9007199254740993 } "s;
+        assert(handler.GetEvents() == expected);
+
+        // Токены, разрезанные границей куска, дочитываются из следующего
+        for (size_t chunk_size : {1, 2, 3, 7, 64})
+        {
+            assert(ParseInChunks(text, chunk_size) == expected);
+        }
+        assert(ParseInChunks("12345"sv, 2) == "i:12345 "s);
+        assert(ParseInChunks("\"a\\nb\""sv, 3) == "s:a\nb "s);
+        // Последовательность \uXXXX и суррогатная пара могут оборваться на любом символе
+        for (size_t chunk_size : {1, 2, 3, 5})
+        {
+            assert(ParseInChunks(R"("a\u00e9\ud83d\ude00b")"sv, chunk_size) == "s:a\xC3\xA9\xF0\x9F\x98\x80" "b "s);
+        }
+
+        // Всё, что после корневого значения, не разбирается
+        RecordingHandler tail;
+        SaxParser parser(tail);
+        parser.Feed("[1] [2"sv);
+        assert(parser.IsDone());
+        parser.Finish();
+        assert(tail.GetEvents() == "[ i:1 ] "s);
+
+        for (std::string_view broken : {"[1, 2"sv, "{\"a\": 1"sv, "\"abc"sv, "tru"sv, "{\"a\" 1}"sv, ""sv})
+        {
+            for (size_t chunk_size : {1, 64})
+            {
+                try
+                {
+                    ParseInChunks(broken, chunk_size);
+                    assert(false);
+                }
+                catch (const ParsingError &)
+                {
+                    // ok
+                }
+            }
+        }
+    }
+
+    void TestWriter()
+    {
+        const Node node{Dict{{"list"s, Array{1, -2.5, nullptr, true, "s"s}}, {"empty"s, Dict{}}, {"big"s, int64_t{9007199254740993}}}};
+        const std::string text = ToString(Document{node});
+        assert(text == R"({ "big" : 9007199254740993 , "empty" : {  } , "list" : [1,-2.5,null,true,"s"] })"s);
+        assert(Print(node) == text);
+        assert(LoadJSON(text).GetRoot() == node);
+
+        // Экранируемые символы в начале, в конце и на границах 16-байтовых блоков
+        std::string long_string;
+        for (int i = 0; i < 100; ++i)
+        {
+            long_string += i % 17 == 0 ? "\"\\\n\r\t"s : "plain text "s;
+        }
+        const Node str_node{long_string};
+        assert(LoadJSON(ToString(Document{str_node})).GetRoot() == str_node);
+        std::ostringstream escaped;
+        PrintEscape("a\"b\\c\nd"sv, escaped);
+        assert(escaped.str() == R"(a\"b\\c\nd)"s);
+
+        // Все управляющие символы: разбор, вывод и повторный разбор дают ту же строку,
+        // а в выведенном тексте нет ни одного байта меньше 0x20
+        std::string escapes_text = "[\""s;
+        std::string controls;
+        for (int code = 0; code < 0x20; ++code)
+        {
+            static constexpr char kHexDigits[] = "0123456789ABCDEF";
+            escapes_text += "\\u00"s + kHexDigits[code / 16] + kHexDigits[code % 16];
+            controls += static_cast<char>(code);
+        }
+        escapes_text += "\", \"\\b\\f\\n\\r\\t\"]"s;
+        const Document controls_doc = LoadJSON(escapes_text);
+        assert(controls_doc.GetRoot().AsArray()[0].AsString() == controls);
+        assert(controls_doc.GetRoot().AsArray()[1].AsString() == "\b\f\n\r\t"s);
+        for (const std::string &printed : {ToString(controls_doc), Print(Node{controls + long_string + controls})})
+        {
+            assert(std::none_of(printed.begin(), printed.end(), [](char c)
+                                { return static_cast<unsigned char>(c) < 0x20; }));
+            assert(Validate(printed).IsValid());
+        }
+        assert(LoadJSON(ToString(controls_doc)) == controls_doc);
+        assert(ToString(Document{Node{"\x01\b\x1f"s}}) == R"("\u0001\b\u001f")"s);
+        assert(LoadJSON(Print(Node{controls + long_string + controls})).GetRoot().AsString() == controls + long_string + controls);
+
+        // Кратчайшая запись, которая читается обратно без потерь
+        assert(ToString(Document{Node{0.1 + 0.2}}) == "0.30000000000000004"s);
+        assert(ToString(Document{Node{1234567.5}}) == "1234567.5"s);
+        assert(LoadJSON(ToString(Document{Node{1e-300}})).GetRoot().AsDouble() == 1e-300);
+
+        // Повторное использование буфера
+        std::string buffer;
+        Writer writer(buffer);
+        writer.WriteNode(node);
+        const size_t capacity = buffer.capacity();
+        writer.Clear();
+        const size_t allocations_before = allocation_count;
+        writer.WriteNode(node);
+        assert(allocation_count == allocations_before);
+        assert(buffer == text && buffer.capacity() == capacity);
+        writer.Clear();
+        writer.WriteString("x\ty"sv);
+        writer.WriteRaw(","sv);
+        writer.WriteDouble(0.5);
+        assert(writer.GetData() == R"("x\ty",0.5)"sv);
+    }
+
+    void TestLines()
+    {
+        // Больше нескольких минимальных кусков, чтобы разбор действительно шёл параллельно
+        std::string text;
+        std::vector<Node> expected;
+        for (int i = 0; i < 20'000; ++i)
+        {
+            expected.push_back(Node{Dict{{"id"s, i}, {"name"s, "record "s + std::to_string(i)}}});
+            text += ToString(Document{expected.back()}) + (i % 3 == 0 ? "\r\n"s : "\n"s);
+            if (i % 1'000 == 0)
+            {
+                text += " \t\n"s;
+            }
+        }
+        for (size_t threads : {1, 2, 4, 0})
+        {
+            const std::vector<Document> documents = LoadLines(text, {}, threads);
+            assert(documents.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                assert(documents[i].GetRoot() == expected[i]);
+            }
+        }
+
+        size_t next = 0;
+        LoadLines(text, [&](Document document)
+                  { assert(document.GetRoot() == expected[next++]); }, {}, 4);
+        assert(next == expected.size());
+        assert(LoadLines(""sv).empty());
+        assert(LoadLines("1\n\n[2]"sv).size() == 2);
+
+        // Номер строки считается с учётом пустых строк и строк из других кусков
+        std::string broken = text;
+        const size_t line_start = broken.find("{ \"id\" : 15000 "s);
+        broken.insert(line_start, "x"s);
+        const size_t broken_line = std::count(broken.begin(), broken.begin() + line_start, '\n') + 1;
+        try
+        {
+            LoadLines(broken, {}, 4);
+            assert(false);
+        }
+        catch (const ParsingError &e)
+        {
+            assert(e.what() == "Line "s + std::to_string(broken_line) + ": Unexpected symbol"s);
+        }
+
+        // На строке одна запись: вторая запись или мусор после неё не отбрасываются молча
+        LoadOptions indexed;
+        indexed.use_structural_index = true;
+        assert(LoadLines("[1] \t\r\n\"s\"\n2 \n"sv, indexed).size() == 3);
+        for (const LoadOptions &line_options : {LoadOptions{}, indexed})
+        {
+            for (const std::string_view text_with_tail : {"[1]\n{\"a\":1} {\"b\":2}\n[3]\n"sv, "[1]\n{\"a\":1}x\n"sv, "[1]\n\"s\" 2\n"sv, "[1]\n7 ]\n"sv, "[1]\n1x\n"sv})
+            {
+                try
+                {
+                    LoadLines(text_with_tail, line_options, 2);
+                    assert(false);
+                }
+                catch (const ParsingError &e)
+                {
+                    assert(e.what() == "Line 2: Redundant data after document"s);
+                }
+            }
+        }
+
+        const TempFile file{text};
+        LoadOptions options;
+        options.borrow_strings = true;
+        std::vector<Document> borrowed = LoadLinesFile(file.GetPath(), options, 4);
+        assert(borrowed.size() == expected.size());
+        // Документы продлевают жизнь отображению файла
+        const Document last = borrowed.back();
+        borrowed.clear();
+        assert(last.GetRoot() == expected.back());
+    }
+
+    void TestParallelArray()
+    {
+        // Запятые, скобки и кавычки внутри строк не должны становиться границами кусков
+        std::string text = "[ "s;
+        for (int i = 0; i < 30'000; ++i)
+        {
+            text += i == 0 ? ""s : (i % 7 == 0 ? ","s : ", "s);
+            text += "{\"id\": "s + std::to_string(i) + ", \"tricky\": \"],[\\\" ,\\\\\", \"list\": [1.5, [true, null]]}"s;
+            if (i % 1'000 == 0)
+            {
+                text += ", 12345, \"str\", false"s;
+            }
+        }
+        text += "] tail"s;
+
+        const Document sequential = Load(text);
+        assert(sequential.GetRoot().AsArray().size() == 30'000 + 30 * 3);
+        LoadOptions options;
+        options.threads = 4;
+        assert(Load(text, options) == sequential);
+        options.use_arena = true;
+        assert(Load(text, options) == sequential);
+        options.use_arena = false;
+        options.borrow_strings = true;
+        const Document borrowed = Load(text, options);
+        assert(borrowed == sequential);
+        assert(borrowed.GetRoot().AsArray().back().AsMap().at("tricky"sv).AsString() == "],[\" ,\\"s);
+
+        // Ошибка та же, что при последовательном разборе, даже если куски с ошибками разбирались параллельно.
+        // Пропущенная запятая могла бы прийтись на границу кусков
+        const size_t gap = text.find(", {\"id\": 20000,"s);
+        for (const std::string &broken : {text.substr(0, gap) + " "s + text.substr(gap + 1),
+                                          text.substr(0, text.size() - 10), text.substr(0, gap) + "x"s + text.substr(gap),
+                                          text.substr(0, gap) + ","s + text.substr(gap),
+                                          "[,"s + text.substr(1), text.substr(0, text.rfind(']')) + ",]"s})
+        {
+            std::string sequential_error;
+            std::string parallel_error;
+            try
+            {
+                Load(broken);
+            }
+            catch (const ParsingError &e)
+            {
+                sequential_error = e.what();
+            }
+            try
+            {
+                Load(broken, options);
+            }
+            catch (const ParsingError &e)
+            {
+                parallel_error = e.what();
+            }
+            assert(!sequential_error.empty());
+            assert(parallel_error == sequential_error);
+        }
+    }
+
+    void TestParallelPrint()
+    {
+        // Маленький документ и большие поддеревья на разной глубине
+        Array records;
+        for (int i = 0; i < 5'000; ++i)
+        {
+            records.emplace_back(Dict{{"id"s, i}, {"name"s, "record \"" + std::to_string(i) + "\"\n"s}, {"values"s, Array{1.5, nullptr, true}}});
+        }
+        Dict wide;
+        for (int i = 0; i < 3'000; ++i)
+        {
+            wide.emplace("key"s + std::to_string(i), Array{i, "v"s});
+        }
+        const Node big{Dict{{"records"s, records}, {"wide"s, wide}, {"small"s, Array{1, 2}}}};
+        for (const Node &node : {Node{Array{1, "s"s}}, big, Node{Array{big, 42}}})
+        {
+            const Document doc{node};
+            const std::string sequential = ToString(doc);
+            for (size_t threads : {2, 4, 0})
+            {
+                PrintOptions options;
+                options.threads = threads;
+                assert(ToString(doc, options) == sequential);
+                std::ostringstream out;
+                Print(doc, out, options);
+                assert(out.str() == sequential);
+            }
+        }
+    }
+
+    void TestLazy()
+    {
+        const std::string text = R"( {"id": 7, "name": "esc\"aped", "skip": [{"deep": [1, 2, {"x": "]}"}]}, "\\"], "list": [1, 2.5, null, true, [3]], "k\"ey": false, "id": 8} )"s;
+        const LazyDocument doc = LoadLazy(text);
+        const LazyNode root = doc.GetRoot();
+        assert(root.IsMap());
+        // Повторяющийся ключ: как и в Dict, находится первое значение
+        assert(root["id"sv].AsInt() == 7);
+        assert(root["name"sv].AsString() == "esc\"aped"s);
+        assert(root["k\"ey"sv].IsBool() && !root["k\"ey"sv].AsBool());
+        assert(root.AsMap().size() == 6);
+        assert(root.AsMap().count("skip"sv) == 1);
+        assert(root.AsMap().count("missing"sv) == 0);
+
+        const LazyArray list = root["list"sv].AsArray();
+        assert(list.size() == 5);
+        assert(list.at(1).AsDouble() == 2.5);
+        assert(list.at(2).IsNull());
+        assert(root["list"sv][4][size_t{0}].AsInt() == 3);
+        assert(root["skip"sv].GetText() == R"([{"deep": [1, 2, {"x": "]}"}]}, "\\"])"sv);
+
+        // Полный разбор значения даёт то же, что и обычный Load
+        const Document eager = Load(text);
+        assert(root["skip"sv].Materialize().GetRoot() == eager.GetRoot().AsMap().at("skip"sv));
+        assert(root.Materialize() == eager);
+
+        try
+        {
+            root["missing"sv];
+            assert(false);
+        }
+        catch (const std::out_of_range &)
+        {
+            // ok
+        }
+        MustThrowLogicError([&root]
+                            { root["id"sv].AsString(); });
+        MustThrowLogicError([&root]
+                            { root.AsArray(); });
+
+        // Ошибка в пропущенной части не мешает читать остальное,
+        // а ошибка в прочитанной части сообщается при обращении
+        const LazyDocument broken = LoadLazy(R"({"good": 1, "bad": [tru, 1.], "tail": )"sv);
+        assert(broken.GetRoot()["good"sv].AsInt() == 1);
+        try
+        {
+            broken.GetRoot()["bad"sv][size_t{0}].AsBool();
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+        try
+        {
+            broken.GetRoot()["tail"sv];
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+        // Число с лишними символами за ним - ошибка, как и в Load
+        const auto must_fail = [](const auto &fn)
+        {
+            try
+            {
+                fn();
+                assert(false);
+            }
+            catch (const ParsingError &)
+            {
+                // ok
+            }
+        };
+        must_fail([]
+                  { LoadLazy("[1x]"sv).GetRoot()[size_t{0}].AsInt(); });
+        must_fail([]
+                  { LoadLazy("[1x]"sv).GetRoot()[size_t{0}].IsInt(); });
+        must_fail([]
+                  { LoadLazy(R"({"a":1x})"sv).GetRoot()["a"sv].AsInt(); });
+        assert(LoadLazy(R"({"a":1,"b":[2]})"sv).GetRoot()["a"sv].AsInt() == 1);
+        assert(LoadLazy("[2]"sv).GetRoot()[size_t{0}].AsInt() == 2);
+
+        const TempFile file{text};
+        const LazyDocument from_file = LoadLazyFile(file.GetPath());
+        assert(from_file.GetRoot()["name"sv].AsString() == "esc\"aped"s);
+    }
+
+    void TestInternKeys()
+    {
+        const std::string long_key = "a_rather_long_key_name"s;
+        std::string text = "["s;
+        for (int i = 0; i < 100; ++i)
+        {
+            text += "{\""s + long_key + "\": "s + std::to_string(i) + ", \"id\": 1, \"esc\\\"aped\": {\"id\": 2}},"s;
+        }
+        text += "{}]"s;
+
+        LoadOptions options;
+        options.intern_keys = true;
+        const Document plain = Load(text);
+        const Document interned = Load(text, options);
+        assert(interned == plain);
+
+        const Array &items = interned.GetRoot().AsArray();
+        const Dict &first = items[0].AsMap();
+        const Dict &second = items[1].AsMap();
+        assert(first.begin()->first.IsInterned());
+        // Одинаковые ключи документа ссылаются на одну строку таблицы
+        assert(first.begin()->first.data() == second.begin()->first.data());
+        assert(first.at("esc\"aped"sv).AsMap().at("id"sv).AsInt() == 2);
+        assert(!plain.GetRoot().AsArray()[0].AsMap().begin()->first.IsInterned());
+
+        // Копия не зависит от таблицы и переживает документ
+        Node copy;
+        {
+            const Document temporary = Load(text, options);
+            copy = temporary.GetRoot().AsArray()[5];
+        }
+        assert(!copy.AsMap().begin()->first.IsInterned());
+        assert(copy.AsMap().at(long_key).AsInt() == 5);
+
+        const MemoryUsage plain_usage = plain.GetMemoryUsage();
+        const MemoryUsage usage = interned.GetMemoryUsage();
+        assert(plain_usage.interned_keys == 0 && plain_usage.interned_bytes_saved == 0);
+        assert(usage.interned_keys == 400);
+        assert(usage.interned_bytes_saved == 99 * long_key.size());
+        assert(usage.string_bytes < plain_usage.string_bytes);
+
+        options.use_arena = true;
+        options.threads = 4;
+        assert(Load(text, options) == plain);
+    }
+
+    void TestBinary()
+    {
+        Array ints;
+        for (int64_t value : std::initializer_list<int64_t>{0, 127, 128, 255, 256, 65'535, 65'536, 4'294'967'295, 4'294'967'296,
+                                                             -1, -32, -33, -128, -129, -32'768, -32'769, -2'147'483'648, -2'147'483'649,
+                                                             std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()})
+        {
+            ints.emplace_back(value);
+        }
+        Dict wide;
+        for (int i = 0; i < 20; ++i)
+        {
+            wide.emplace("key"s + std::to_string(i), i % 2 == 0 ? Node{i} : Node{std::to_string(i)});
+        }
+        const Node root{Dict{{"ints"s, ints},
+                             {"doubles"s, Array{1.0, -0.5, 1e300, 0.1}},
+                             {"strings"s, Array{""s, std::string(31, 's'), std::string(32, 's'), std::string(300, 'm'), std::string(70'000, 'l')}},
+                             {"literals"s, Array{nullptr, true, false}},
+                             {"wide"s, wide},
+                             {"long"s, Array(70'000, Node{1})},
+                             {"empty"s, Dict{}}}};
+        const Document doc{root};
+        const std::string binary = SaveBinary(doc);
+        const Document loaded = LoadBinary(binary);
+        assert(loaded == doc);
+        // Вещественное остаётся вещественным, даже если равно целому
+        assert(loaded.GetRoot().AsMap().at("doubles"sv).AsArray()[0].IsPureDouble());
+        assert(loaded.GetRoot().AsMap().at("ints"sv).AsArray().back().IsInt64());
+        assert(ToString(loaded) == ToString(doc));
+
+        assert(SaveBinary(Document{Dict{{"a"s, 1}}}) == "\x81\xa1"s "a\x01"s);
+        std::string buffer = "prefix"s;
+        SaveBinary(Document{Node{-1}}, buffer);
+        assert(buffer == "prefix\xff"s);
+
+        // Заимствованные строки записываются как обычные
+        LoadOptions options;
+        options.borrow_strings = true;
+        const std::string text = R"({"name": "borrowed", "list": [1, 2.5]})"s;
+        assert(LoadBinary(SaveBinary(Load(text, options))) == Load(text));
+
+        // Типы, которые пишут другие реализации
+        assert(LoadBinary("\xca\x3f\xc0\x00\x00"s).GetRoot().AsDouble() == 1.5);
+        assert(LoadBinary("\xcf\xff\xff\xff\xff\xff\xff\xff\xff"s).GetRoot().IsPureDouble());
+
+        for (const std::string &broken : {""s, "\x92\x01"s, "\xa5"s "abc"s, "\xc4\x01x"s, "\x81\x01\x02"s, "\x01\x02"s, "\xdd\xff\xff\xff\xff"s})
+        {
+            try
+            {
+                LoadBinary(broken);
+                assert(false);
+            }
+            catch (const ParsingError &)
+            {
+                // ok
+            }
+        }
+    }
+
+    void TestSnapshot()
+    {
+        Dict wide;
+        for (int i = 0; i < 100; ++i)
+        {
+            wide.emplace("key"s + std::to_string(i), Dict{{"id"s, i}, {"name"s, "item "s + std::to_string(i)}});
+        }
+        const Node root{Dict{{"ints"s, Array{0, -1, int64_t{1'000'000'000'000}, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()}},
+                             {"doubles"s, Array{1.0, -0.5, 1e300}},
+                             {"literals"s, Array{nullptr, true, false}},
+                             {"strings"s, Array{""s, "esc\"aped\n"s, std::string(1'000, 'x')}},
+                             {"wide"s, wide},
+                             {"empty"s, Array{}},
+                             {"empty_dict"s, Dict{}}}};
+        const Document doc{root};
+        const std::string data = SaveSnapshot(doc);
+        // Снимок детерминирован
+        assert(SaveSnapshot(doc) == data);
+
+        const SnapshotDocument snapshot = LoadSnapshot(data);
+        const SnapshotNode node = snapshot.GetRoot();
+        assert(node.IsMap() && node.AsMap().size() == 7);
+        assert(node.Materialize() == doc);
+        assert(node["ints"sv][2].IsInt64() && !node["ints"sv][2].IsInt());
+        assert(node["ints"sv][3].AsInt64() == std::numeric_limits<int64_t>::min());
+        assert(node["ints"sv][1].AsInt() == -1);
+        assert(node["doubles"sv][size_t{0}].IsPureDouble() && node["doubles"sv][size_t{0}].AsDouble() == 1.0);
+        assert(node["literals"sv][size_t{0}].IsNull() && node["literals"sv][1].AsBool());
+        assert(node["strings"sv][1].AsString() == "esc\"aped\n"sv);
+        assert(node["wide"sv]["key57"sv]["name"sv].AsString() == "item 57"sv);
+        assert(node["wide"sv].AsMap().count("key100"sv) == 0);
+        assert(node["empty"sv].AsArray().empty());
+
+        // Пары перебираются в порядке ключей, как в Dict
+        auto dict_it = wide.begin();
+        for (const auto &[key, value] : node["wide"sv].AsMap())
+        {
+            assert(key == dict_it->first);
+            assert(value["id"sv].AsInt() == dict_it->second.AsMap().at("id"sv).AsInt());
+            ++dict_it;
+        }
+        assert(dict_it == wide.end());
+
+        try
+        {
+            node["missing"sv];
+            assert(false);
+        }
+        catch (const std::out_of_range &)
+        {
+            // ok
+        }
+        MustThrowLogicError([&node]
+                            { node["ints"sv].AsMap(); });
+        MustThrowLogicError([&node]
+                            { node["strings"sv][size_t{0}].AsInt(); });
+
+        const TempFile file{data};
+        const SnapshotDocument from_file = LoadSnapshotFile(file.GetPath());
+        assert(from_file.GetRoot()["wide"sv]["key3"sv]["id"sv].AsInt() == 3);
+
+        // Заголовок проверяется сразу, испорченные данные - при обращении
+        try
+        {
+            LoadSnapshot("not a snapshot at all"sv);
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+        const SnapshotDocument truncated = LoadSnapshot(std::string_view(data).substr(0, data.size() / 2));
+        try
+        {
+            for (const auto &[key, value] : truncated.GetRoot()["wide"sv].AsMap())
+            {
+                value["name"sv].AsString();
+            }
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+
+        // Элемент, ссылающийся на свой массив или на предка, не уводит обход в бесконечную рекурсию
+        const std::string nested = SaveSnapshot(Load("[[0], {\"a\": [0]}]"s));
+        uint64_t root_block;
+        std::memcpy(&root_block, nested.data() + 16, sizeof(root_block));
+        for (const size_t item_offset : {size_t{0}, size_t{8}})
+        {
+            std::string cyclic = nested;
+            std::memcpy(cyclic.data() + root_block + 16 + item_offset, &root_block, sizeof(root_block));
+            const SnapshotDocument corrupted = LoadSnapshot(cyclic);
+            const auto must_fail = [](const auto &fn)
+            {
+                try
+                {
+                    fn();
+                    assert(false);
+                }
+                catch (const ParsingError &)
+                {
+                    // ok
+                }
+            };
+            must_fail([&corrupted]
+                      { corrupted.GetRoot().Materialize(); });
+            must_fail([&corrupted]
+                      { std::vector<SnapshotNode> found;
+                        Path("$..a"sv).Select(corrupted.GetRoot(), found); });
+        }
+        // Ссылка назад глубже корня: элемент вложенного массива указывает на корень
+        std::string ancestor = nested;
+        uint64_t first_item;
+        std::memcpy(&first_item, nested.data() + root_block + 16, sizeof(first_item));
+        std::memcpy(ancestor.data() + first_item + 16, &root_block, sizeof(root_block));
+        try
+        {
+            LoadSnapshot(ancestor).GetRoot().Materialize();
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+
+        // Записи, ссылающиеся на блок соседа, не дают материализации расти экспоненциально
+        std::string shared = "0"s;
+        for (int i = 0; i < 30; ++i)
+        {
+            shared = "["s + shared + ", null]"s;
+        }
+        std::string dag = SaveSnapshot(Load(shared));
+        uint64_t block;
+        std::memcpy(&block, dag.data() + 16, sizeof(block));
+        for (int i = 0; i < 30; ++i)
+        {
+            uint64_t first;
+            std::memcpy(&first, dag.data() + block + 16, sizeof(first));
+            std::memcpy(dag.data() + block + 24, &first, sizeof(first));
+            block = first;
+        }
+        assert(LoadSnapshot(dag).GetRoot()[1][1][0][1].IsArray());
+        try
+        {
+            LoadSnapshot(dag).GetRoot().Materialize();
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+
+        // Материализация ограничивает вложенность так же, как Load
+        LoadOptions shallow;
+        shallow.max_depth = 3;
+        assert(LoadSnapshot(nested).GetRoot().Materialize(shallow) == Load("[[0], {\"a\": [0]}]"s));
+        shallow.max_depth = 2;
+        try
+        {
+            LoadSnapshot(nested).GetRoot().Materialize(shallow);
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+    }
+
+    void TestPath()
+    {
+        const std::string text = R"({"store": {"book": [{"title": "A", "price": 8.5, "tags": ["x"]}, {"title": "B", "price": 12},
+                                                       {"title": "C", "price": 5, "isbn": "0-1"}],
+                                             "bicycle": {"color": "red", "price": 19.5}},
+                                   "a/b": 1, "m~n": 2, "": 3, "0": "zero", "arr": [[0, 1], [2, 3]]})"s;
+        const Document doc = Load(text);
+        const Node &root = doc.GetRoot();
+
+        assert(Pointer(""sv).Find(root) == &root);
+        assert(Pointer("/store/book/1/title"sv).Find(root)->AsString() == "B"s);
+        assert(Pointer("/a~1b"sv).Find(root)->AsInt() == 1);
+        assert(Pointer("/m~0n"sv).Find(root)->AsInt() == 2);
+        assert(Pointer("/"sv).Find(root)->AsInt() == 3);
+        // Число - ключ для словаря и номер для массива
+        assert(Pointer("/0"sv).Find(root)->AsString() == "zero"s);
+        assert(Pointer("/arr/1/0"sv).Find(root)->AsInt() == 2);
+        for (std::string_view missing : {"/store/book/-"sv, "/store/book/01"sv, "/store/book/3"sv, "/store/bicycle/color/x"sv, "/nothing"sv})
+        {
+            assert(Pointer(missing).Find(root) == nullptr);
+        }
+
+        const auto select = [&root](std::string_view path)
+        {
+            std::vector<const Node *> result;
+            Path(path).Select(root, result);
+            return result;
+        };
+        const auto titles = select("$.store.book[*].title"sv);
+        assert(titles.size() == 3 && titles[0]->AsString() == "A"s && titles[2]->AsString() == "C"s);
+        double sum = 0;
+        for (const Node *price : select("$..price"sv))
+        {
+            sum += price->AsDouble();
+        }
+        assert(sum == 8.5 + 12 + 5 + 19.5);
+        assert(select("$['store'][\"bicycle\"].color"sv).at(0)->AsString() == "red"s);
+        assert(select("$.arr[1][0]"sv).at(0)->AsInt() == 2);
+        assert(select("$.store.book[5]"sv).empty());
+        assert(select("$..book[2].isbn"sv).at(0)->AsString() == "0-1"s);
+        assert(select("$.arr.*"sv).size() == 2);
+        assert(select("$..[0]"sv).size() == 5);
+        assert(select("$"sv).at(0) == &root);
+
+        // Запрос разобран один раз, а выполнение с тем же буфером результатов не выделяет память
+        const Path compiled("$.store.book[*].price"sv);
+        const Pointer pointer("/store/bicycle/price"sv);
+        std::vector<const Node *> result;
+        compiled.Select(root, result);
+        const size_t allocations_before = allocation_count;
+        for (int i = 0; i < 100; ++i)
+        {
+            result.clear();
+            compiled.Select(root, result);
+            assert(pointer.Find(root)->AsDouble() == 19.5);
+        }
+        assert(allocation_count == allocations_before);
+        assert(result.size() == 3);
+
+        // Те же запросы над ленивым документом и снимком
+        const LazyDocument lazy = LoadLazy(text);
+        assert(Pointer("/store/book/1/title"sv).Find(lazy.GetRoot())->AsString() == "B"s);
+        assert(!Pointer("/store/book/3"sv).Find(lazy.GetRoot()));
+        std::vector<LazyNode> lazy_result;
+        Path("$..price"sv).Select(lazy.GetRoot(), lazy_result);
+        assert(lazy_result.size() == 4);
+        lazy_result.clear();
+        Path("$.store.book[*]"sv).Select(lazy.GetRoot(), lazy_result);
+        assert(lazy_result.size() == 3 && lazy_result[2].Materialize().GetRoot() == *select("$.store.book[2]"sv).at(0));
+
+        const std::string snapshot_data = SaveSnapshot(doc);
+        const SnapshotDocument snapshot = LoadSnapshot(snapshot_data);
+        assert(Pointer("/a~1b"sv).Find(snapshot.GetRoot())->AsInt() == 1);
+        std::vector<SnapshotNode> snapshot_result;
+        Path("$..title"sv).Select(snapshot.GetRoot(), snapshot_result);
+        assert(snapshot_result.size() == 3 && snapshot_result[1].AsString() == "B"sv);
+
+        for (std::string_view broken : {"a"sv, "/~2"sv, "/x~"sv})
+        {
+            try
+            {
+                Pointer{broken};
+                assert(false);
+            }
+            catch (const ParsingError &)
+            {
+                // ok
+            }
+        }
+        for (std::string_view broken : {""sv, "store"sv, "$."sv, "$["sv, "$[-1]"sv, "$['x"sv, "$[1"sv, "$x"sv})
+        {
+            try
+            {
+                Path{broken};
+                assert(false);
+            }
+            catch (const ParsingError &)
+            {
+                // ok
+            }
+        }
+    }
+
+    void TestIncremental()
+    {
+        const std::string text = R"({"name": "esc\"aped é", "list": [1, -2.5e1, true, null, []], "nested": {"long": ")"s + std::string(100, 'x') + R"("}, "big": 9007199254740993})"s;
+        const Document expected = Load(text);
+        for (size_t fragment : {1, 2, 3, 7, 64, 1'000})
+        {
+            LoadOptions options;
+            options.intern_keys = fragment % 2 == 1;
+            options.use_arena = fragment > 10;
+            IncrementalParser parser(options);
+            for (size_t pos = 0; pos < text.size(); pos += fragment)
+            {
+                // Кусок живёт только во время Feed, как буфер сокета
+                const std::string chunk = text.substr(pos, fragment);
+                const ParseStatus status = parser.Feed(chunk);
+                assert(status == (pos + fragment < text.size() ? ParseStatus::NeedMore : ParseStatus::Done));
+            }
+            assert(parser.Finish() == ParseStatus::Done);
+            assert(parser.TakeDocument() == expected);
+        }
+
+        // Число в корне заканчивается только с концом входа
+        IncrementalParser number;
+        assert(number.Feed("12"sv) == ParseStatus::NeedMore);
+        assert(number.Feed("3"sv) == ParseStatus::NeedMore);
+        MustThrowLogicError([&number]
+                            { number.TakeDocument(); });
+        assert(number.Finish() == ParseStatus::Done);
+        assert(number.TakeDocument().GetRoot().AsInt() == 123);
+
+        // После корневого значения ничего не разбирается
+        IncrementalParser tail;
+        assert(tail.Feed("[1] [oops"sv) == ParseStatus::Done);
+        assert(tail.GetConsumed() == 3);
+        assert(tail.Feed("garbage"sv) == ParseStatus::Done);
+        assert(tail.GetConsumed() == 0);
+        assert(tail.TakeDocument().GetRoot() == Node{Array{1}});
+
+        // Load из потока не забирает то, что идёт после документа: следующий Load читает дальше
+        std::istringstream stream("[1] {\"a\": 2}\n3 \"s\"true "s + text + " [oops"s);
+        assert(Load(stream).GetRoot() == Node{Array{1}});
+        assert(Load(stream).GetRoot() == Node(Dict{{"a"s, 2}}));
+        assert(Load(stream).GetRoot().AsInt() == 3);
+        assert(Load(stream).GetRoot().AsString() == "s"s);
+        assert(Load(stream).GetRoot().AsBool());
+        assert(Load(stream) == expected);
+        assert(stream.get() == ' ' && stream.get() == '[');
+        try
+        {
+            Load(stream);
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+            // ok
+        }
+
+        // Документы длиннее буфера файлового потока
+        std::string records;
+        for (int i = 0; i < 3; ++i)
+        {
+            records += "["s;
+            for (int j = 0; j < 20'000; ++j)
+            {
+                records += (j == 0 ? ""s : ", "s) + std::to_string(i * j);
+            }
+            records += "]\n"s;
+        }
+        const TempFile file{records};
+        std::ifstream file_stream(file.GetPath(), std::ios::binary);
+        for (int i = 0; i < 3; ++i)
+        {
+            const Document doc = Load(file_stream);
+            assert(doc.GetRoot().AsArray().size() == 20'000);
+            assert(doc.GetRoot().AsArray().back().AsInt() == i * 19'999);
+        }
+
+        IncrementalParser broken;
+        assert(broken.Feed("[1, 2"sv) == ParseStatus::NeedMore);
+        assert(broken.Feed(", }"sv) == ParseStatus::Error);
+        assert(!broken.GetError().empty());
+        assert(broken.Feed("]"sv) == ParseStatus::Error);
+        assert(broken.Finish() == ParseStatus::Error);
+
+        IncrementalParser unfinished;
+        assert(unfinished.Feed("{\"a\": [1"sv) == ParseStatus::NeedMore);
+        assert(unfinished.Finish() == ParseStatus::Error);
+        assert(unfinished.GetError() == "Expected ']'"s);
+    }
+
+    void TestDepth()
+    {
+        LoadOptions unlimited_options;
+        unlimited_options.max_depth = 0;
+        LoadOptions shallow;
+        shallow.max_depth = 3;
+        LoadOptions shallow_indexed = shallow;
+        shallow_indexed.use_structural_index = true;
+        for (const LoadOptions &options : {shallow, shallow_indexed})
+        {
+            assert(Load(R"([{"a": [1]}, []])"sv, options).GetRoot().AsArray().size() == 2);
+            for (const std::string_view text : {"[[[[1]]]]"sv, R"({"a": {"b": {"c": {}}}})"sv, R"([{"a": [[]]}])"sv})
+            {
+                try
+                {
+                    Load(text, options);
+                    assert(false);
+                }
+                catch (const ParsingError &e)
+                {
+                    assert(e.what() == "Maximum nesting depth exceeded"s);
+                }
+            }
+        }
+
+        // По умолчанию допускается 1000 уровней: на всех путях разбора и в Validate
+        assert(LoadOptions{}.max_depth == 1'000);
+        const auto nested = [](size_t depth, std::string_view open, std::string_view close)
+        {
+            std::string text;
+            for (size_t i = 0; i < depth; ++i)
+            {
+                text += open;
+            }
+            for (size_t i = 0; i < depth; ++i)
+            {
+                text += close;
+            }
+            return text;
+        };
+        for (const auto &[open, close] : {std::pair{"["sv, "]"sv}, std::pair{"{\"k\":["sv, "]}"sv}})
+        {
+            // Во втором случае уровень - это словарь и массив в нём
+            const size_t per_level = open.size() == 1 ? 1 : 2;
+            const std::string limit = nested(1'000 / per_level, open, close);
+            const std::string over_limit = "["s + limit + "]"s;
+            assert(LoadJSON(limit) == Load(limit, unlimited_options));
+            MustFailToLoad(over_limit);
+            IncrementalParser at_limit;
+            assert(at_limit.Feed(limit) == ParseStatus::Done);
+            IncrementalParser past_limit;
+            assert(past_limit.Feed(over_limit) == ParseStatus::Error);
+            assert(past_limit.GetError() == "Maximum nesting depth exceeded"s);
+            assert(Load(over_limit, unlimited_options).GetRoot().IsArray());
+        }
+
+        // Враждебный вход отвергается, а не переполняет стек
+        constexpr size_t kDepth = 300'000;
+        const std::string deep = std::string(kDepth, '[') + std::string(kDepth, ']');
+        MustFailToLoad(deep);
+        IncrementalParser incremental;
+        assert(incremental.Feed(deep) == ParseStatus::Error);
+        assert(incremental.GetError() == "Maximum nesting depth exceeded"s);
+        const std::string deep_binary = std::string(kDepth, '\x91') + "\xc0"s;
+        try
+        {
+            LoadBinary(deep_binary);
+            assert(false);
+        }
+        catch (const ParsingError &)
+        {
+        }
+
+        // Без ограничения глубокий документ разбирается, выводится и разрушается без рекурсии
+        LoadOptions unlimited;
+        unlimited.max_depth = 0;
+        LoadOptions unlimited_indexed = unlimited;
+        unlimited_indexed.use_structural_index = true;
+        for (const LoadOptions &options : {unlimited, unlimited_indexed})
+        {
+            const Document doc = Load(deep, options);
+            assert(ToString(doc) == deep);
+            PrintOptions parallel;
+            parallel.threads = 4;
+            assert(ToString(doc, parallel) == deep);
+        }
+        std::string deep_dicts;
+        for (size_t i = 0; i < kDepth; ++i)
+        {
+            deep_dicts += R"({"k":[)"sv;
+        }
+        for (size_t i = 0; i < kDepth; ++i)
+        {
+            deep_dicts += "] }"sv;
+        }
+        const Document dicts = Load(deep_dicts, unlimited);
+        const std::string dicts_text = ToString(dicts);
+        assert(dicts_text.compare(0, 20, R"({ "k" : [{ "k" : [{ )"sv) == 0);
+        assert(Load(dicts_text, unlimited).GetRoot().AsMap().size() == 1);
+    }
+
+    void TestStats()
+    {
+        const std::string text = R"({"a": [1, 2.5, "x"], "b": {"c": null}})"s;
+        LoadOptions indexed;
+        indexed.use_structural_index = true;
+        for (LoadOptions options : {LoadOptions{}, indexed})
+        {
+            ParseStats stats;
+            options.stats = &stats;
+            Load(text, options);
+            assert(stats.bytes == text.size());
+            assert(stats.nodes == 7 && stats.containers == 3);
+            assert(stats.strings == 1 && stats.keys == 3 && stats.numbers == 2);
+            assert(stats.string_bytes == 4);
+            assert(stats.max_depth == 2);
+            // Два словаря и массив с буферами и одна строка
+            assert(stats.blocks == 7);
+            assert(stats.total_time >= stats.string_time + stats.number_time + stats.index_time);
+        }
+
+        // Длинный ключ занимает свой блок, а взятый из таблицы документа - нет
+        const std::string long_key = R"({"a key that is too long to be stored inline": 1})"s;
+        ParseStats heap_keys;
+        LoadOptions key_options;
+        key_options.stats = &heap_keys;
+        Load(long_key, key_options);
+        ParseStats interned_keys;
+        key_options.stats = &interned_keys;
+        key_options.intern_keys = true;
+        Load(long_key, key_options);
+        assert(heap_keys.blocks == interned_keys.blocks + 1);
+
+        // Счётчики параллельного разбора сходятся с последовательным
+        std::string records = "["s;
+        for (int i = 0; i < 40'000; ++i)
+        {
+            records += i == 0 ? ""s : ","s;
+            records += R"({"id": )"s + std::to_string(i) + R"(, "tags": ["a", "b"]})"s;
+        }
+        records += "]"s;
+        ParseStats sequential;
+        LoadOptions options;
+        options.stats = &sequential;
+        Load(records, options);
+        ParseStats parallel;
+        options.stats = &parallel;
+        options.threads = 4;
+        Load(records, options);
+        assert(sequential.nodes == 40'000 * 5 + 1 && parallel.nodes == sequential.nodes);
+        assert(parallel.containers == sequential.containers && parallel.keys == sequential.keys);
+        assert(parallel.max_depth == 3 && parallel.blocks == sequential.blocks);
+
+        PrintStats print_stats;
+        PrintOptions print_options;
+        print_options.stats = &print_stats;
+        const Document doc = Load(text);
+        assert(ToString(doc, print_options).size() == print_stats.bytes);
+        assert(print_stats.nodes == 7 && print_stats.max_depth == 2);
+
+        // Обработчики получают счётчики каждого разбора и вывода
+        size_t parsed_nodes = 0;
+        size_t printed_bytes = 0;
+        SetStatsHooks([&parsed_nodes](const ParseStats &stats)
+                      { parsed_nodes += stats.nodes; },
+                      [&printed_bytes](const PrintStats &stats)
+                      { printed_bytes += stats.bytes; });
+        Load(text);
+        const std::string printed = ToString(doc);
+        assert(parsed_nodes == 7 && printed_bytes == printed.size());
+        LoadLines("[1]\n[2]\n"sv);
+        assert(parsed_nodes == 11);
+        SetStatsHooks({}, {});
+        Load(text);
+        ToString(doc);
+        assert(parsed_nodes == 11 && printed_bytes == printed.size());
+    }
+
+    // Одна запись из Benchmark, собранная через Builder
+    void BuildRecord(Builder &builder)
+    {
+        builder.StartDict(7)
+            .Key("int"sv).Value(42)
+            .Key("double"sv).Value(42.1)
+            .Key("null"sv).Value(nullptr)
+            .Key("string"sv).Value("hello"sv)
+            .Key("array"sv).StartArray(3).Value(1).Value(2).Value(3).EndArray()
+            .Key("bool"sv).Value(true)
+            .Key("map"sv).StartDict(1).Key("key"sv).Value("value"sv).EndDict()
+            .EndDict();
+    }
+
+    void TestBuilder()
+    {
+        const Node expected{Dict{
+            {"int"s, 42},
+            {"double"s, 42.1},
+            {"null"s, nullptr},
+            {"string"s, "hello"s},
+            {"array"s, Array{1, 2, 3}},
+            {"bool"s, true},
+            {"map"s, Dict{{"key"s, "value"s}}},
+        }};
+        Builder builder;
+        BuildRecord(builder);
+        assert(builder.IsDone());
+        const Node record = builder.Build();
+        assert(record == expected);
+        assert(!builder.IsDone());
+
+        // Тот же Builder собирает следующий документ, ключи сортируются, как в Dict
+        builder.StartArray(100).Value(int64_t{1} << 40).Value("text"s).Value(Node{Array{Node{}}})
+            .StartDict().Key("b"sv).Value(false).Key("a"sv).Value(0.5).EndDict()
+            .EndArray();
+        const Node array = builder.Build();
+        assert(array.AsArray().capacity() >= 100);
+        assert(ToString(Document{array}) == R"([1099511627776,"text",[null],{ "a" : 0.5 , "b" : false }])"s);
+        assert(Builder().Value("root"sv).Build() == Node{"root"s});
+
+        // Без дерева: текст сразу в буфере Writer, в том же формате, что у ToString
+        std::string buffer;
+        Writer writer(buffer);
+        Builder streaming(writer);
+        BuildRecord(streaming);
+        assert(streaming.IsDone());
+        // Ключи выводятся в порядке вызовов Key
+        assert(buffer.compare(0, 30, R"({ "int" : 42 , "double" : 42.1)"sv) == 0);
+        assert(LoadJSON(buffer).GetRoot() == expected);
+        writer.Clear();
+        Builder(writer).StartArray().Value("a\n"sv).StartDict().EndDict().StartArray().EndArray().Value(1.5).EndArray();
+        assert(buffer == R"(["a\n",{  },[],1.5])"s);
+
+        MustThrowLogicError([]
+                            { Builder().StartDict().Value(1); });
+        MustThrowLogicError([]
+                            { Builder().StartArray().Key("k"sv); });
+        MustThrowLogicError([]
+                            { Builder().StartDict().Key("k"sv).Key("v"sv); });
+        MustThrowLogicError([]
+                            { Builder().StartDict().Key("k"sv).EndDict(); });
+        MustThrowLogicError([]
+                            { Builder().StartDict().EndArray(); });
+        MustThrowLogicError([]
+                            { Builder().Value(1).Value(2); });
+        MustThrowLogicError([]
+                            { Builder().StartArray().Build(); });
+        MustThrowLogicError([]
+                            { Builder().Build(); });
+        MustThrowLogicError([&writer]
+                            { Builder(writer).Value(1).Build(); });
+    }
+
+    void TestCopyOnWrite()
+    {
+        const std::string text = R"({"name":"base","limits":{"cpu":2,"memory":{"soft":1,"hard":4}},"hosts":["a","b"]})"s;
+        for (const bool use_arena : {false, true})
+        {
+            LoadOptions options;
+            options.use_arena = use_arena;
+            const Document base = json::Load(text, options);
+
+            // Копия документа ничего не выделяет и делит с ним все контейнеры
+            const size_t allocations_before = allocation_count;
+            Document overlay = base;
+            assert(allocation_count == allocations_before);
+            assert(&overlay.GetRoot().AsMap() == &base.GetRoot().AsMap());
+
+            Dict &root = overlay.GetMutableRoot().AsMutableMap();
+            root["limits"sv].AsMutableMap()["memory"sv].AsMutableMap()["hard"sv] = 8;
+            root["version"sv] = 2;
+            assert(root.erase("name"sv) == 1 && root.erase("name"sv) == 0);
+
+            // Исходный документ не изменился
+            assert(ToString(base) == ToString(json::Load(text)));
+            assert(overlay.GetRoot().AsMap().at("limits"sv).AsMap().at("memory"sv).AsMap().at("hard"sv) == Node{8});
+            assert(overlay.GetRoot().AsMap().at("version"sv) == Node{2});
+            assert(overlay.GetRoot().AsMap().count("name"sv) == 0);
+            if (!use_arena)
+            {
+                // Скопированы только контейнеры на пути к листу, соседние остались общими
+                assert(&overlay.GetRoot().AsMap().at("hosts"sv).AsArray() == &base.GetRoot().AsMap().at("hosts"sv).AsArray());
+                assert(&overlay.GetRoot().AsMap().at("limits"sv).AsMap() != &base.GetRoot().AsMap().at("limits"sv).AsMap());
+            }
+
+            // Единственный владелец меняет контейнер на месте
+            Node &hosts = overlay.GetMutableRoot().AsMutableMap()["hosts"sv];
+            hosts.AsMutableArray().push_back(Node{"c"s});
+            const Array *hosts_array = &hosts.AsArray();
+            hosts.AsMutableArray().push_back(Node{"d"s});
+            assert(&hosts.AsArray() == hosts_array && hosts.AsArray().size() == 4);
+            assert(base.GetRoot().AsMap().at("hosts"sv).AsArray().size() == 2);
+        }
+
+        // Узлы, перемещённые из документа с памятью документа, переживают сам документ
+        const std::string long_keys = R"({"a key that does not fit inline":{"another long key name":["long string that does not fit into SSO",1]}})"s;
+        for (const auto &[use_arena, intern_keys] : {std::pair{true, false}, std::pair{false, true}, std::pair{true, true}})
+        {
+            LoadOptions options;
+            options.use_arena = use_arena;
+            options.intern_keys = intern_keys;
+            Node subtree;
+            Node root;
+            {
+                Document doc = json::Load(long_keys, options);
+                subtree = std::move(doc.GetMutableRoot().AsMutableMap()["a key that does not fit inline"sv]);
+                root = std::move(doc.GetMutableRoot());
+            }
+            assert(subtree == json::Load(long_keys).GetRoot().AsMap().at("a key that does not fit inline"sv));
+            assert(subtree.AsMap().begin()->first == "another long key name"sv);
+            assert(!subtree.AsMap().begin()->first.IsInterned());
+            subtree.AsMutableMap()["another long key name"sv].AsMutableArray().push_back(Node{2});
+            assert(root.AsMap().count("a key that does not fit inline"sv) == 1);
+            subtree = Node{};
+            root = Node{};
+        }
+
+        // Копия узла из кучи разделяет строку и контейнер, правка копии их отделяет
+        Node original{Array{Node{"long string that does not fit into SSO"s}, Node{Dict{{"k"s, 1}}}}};
+        Node copy = original;
+        assert(&copy.AsArray() == &original.AsArray());
+        assert(&copy.AsArray()[0].AsString() == &original.AsArray()[0].AsString());
+        copy.AsMutableArray()[1].AsMutableMap()["k"sv] = 2;
+        assert(original.AsArray()[1].AsMap().at("k"sv) == Node{1});
+        assert(copy.AsArray()[1].AsMap().at("k"sv) == Node{2});
+        assert(&copy.AsArray()[0].AsString() == &original.AsArray()[0].AsString());
+        original = Node{};
+        assert(copy.AsArray()[0].AsString() == "long string that does not fit into SSO"s);
+
+        // Много версий одного большого документа
+        Array items;
+        for (int i = 0; i < 10'000; ++i)
+        {
+            items.emplace_back(Dict{{"id"s, i}});
+        }
+        std::vector<Document> versions{Document{Node{std::move(items)}}};
+        for (int i = 1; i < 100; ++i)
+        {
+            Document next = versions.back();
+            next.GetMutableRoot().AsMutableArray()[i].AsMutableMap()["id"sv] = -i;
+            versions.push_back(std::move(next));
+        }
+        assert(versions.front().GetRoot().AsArray()[50].AsMap().at("id"sv) == Node{50});
+        assert(versions.back().GetRoot().AsArray()[50].AsMap().at("id"sv) == Node{-50});
+        assert(&versions.front().GetRoot().AsArray()[5'000].AsMap() == &versions.back().GetRoot().AsArray()[5'000].AsMap());
+
+        MustThrowLogicError([]
+                            { Node{1}.AsMutableArray(); });
+        MustThrowLogicError([]
+                            { Node{Array{}}.AsMutableMap(); });
+    }
+
+    void TestValidate()
+    {
+        const auto check_error = [](std::string_view text, std::string_view error, size_t offset, size_t line, size_t column)
+        {
+            const ValidationResult result = Validate(text);
+            assert(!result.IsValid());
+            assert(result.error == error);
+            assert(result.offset == offset && result.line == line && result.column == column);
+        };
+        assert(Validate(" {\"a\": [1, -2.5e3, true, null, \"\\u00e9\\ud83d\\ude00\", {}]}\n"sv).IsValid());
+        check_error(""sv, "Unexpected end of input"sv, 0, 1, 1);
+        check_error("{\n  \"a\": [1,\n    2,]\n}"sv, "Unexpected symbol"sv, 19, 3, 7);
+        check_error("[1 2]"sv, "Expected ',' or ']'"sv, 3, 1, 4);
+        check_error(R"({"a":1,})"sv, "String parsing error"sv, 7, 1, 8);
+        check_error(R"({"a" 1})"sv, "Expected ':'"sv, 5, 1, 6);
+        check_error("[1,"sv, "Expected ']'"sv, 3, 1, 4);
+        check_error("[\"ab\ncd\"]"sv, "Unexpected end of line"sv, 4, 1, 5);
+        check_error(R"(["\q"])"sv, "Unrecognized escape sequence"sv, 2, 1, 3);
+        check_error(R"(["\ud83d\u0041"])"sv, "Invalid surrogate pair"sv, 2, 1, 3);
+        check_error("[tru]"sv, "Similiar to boolean value"sv, 1, 1, 2);
+        check_error("[1.]"sv, "A digit is expected"sv, 1, 1, 2);
+        check_error("1e400"sv, "Failed to convert number"sv, 0, 1, 1);
+
+        // Load не читает дальше корневого значения, а Validate проверяет и хвост
+        assert(json::Load("{} x"sv).GetRoot() == Node{Dict{}});
+        check_error("{} x"sv, "Redundant data after document"sv, 3, 1, 4);
+
+        // Описание ошибки то же, что у Load
+        for (const std::string_view text : {"[1,,2]"sv, "[\"a\" \"b\"]"sv, R"({"a":1 "b":2})"sv, "{\"a\":[1}"sv, R"("\u12G4")"sv, "nulls"sv, "-"sv, "  "sv})
+        {
+            std::string error;
+            try
+            {
+                json::Load(text);
+            }
+            catch (const ParsingError &e)
+            {
+                error = e.what();
+            }
+            assert(!error.empty() && Validate(text).error == error);
+        }
+
+        // Вложенность ограничена так же, как в Load
+        const std::string deep = std::string(1'001, '[') + std::string(1'001, ']');
+        check_error(deep, "Maximum nesting depth exceeded"sv, 1'000, 1, 1'001);
+        LoadOptions unlimited;
+        unlimited.max_depth = 0;
+        assert(Validate(deep, unlimited).IsValid());
+        // Глубже 4096 уровней стек продолжается в куче, и типы скобок по-прежнему различаются
+        std::string mixed;
+        for (int i = 0; i < 10'000; ++i)
+        {
+            mixed += i % 3 == 0 ? "{\"k\":"s : "["s;
+        }
+        mixed += "1"s;
+        for (int i = 10'000 - 1; i >= 0; --i)
+        {
+            mixed += i % 3 == 0 ? "}"s : "]"s;
+        }
+        assert(Validate(mixed, unlimited).IsValid());
+        mixed[mixed.size() - 5'000] = mixed[mixed.size() - 5'000] == '}' ? ']' : '}';
+        assert(!Validate(mixed, unlimited).IsValid());
+
+        // Проверка не выделяет памяти ни на корректном, ни на испорченном документе
+        std::string records = "["s;
+        for (int i = 0; i < 1'000; ++i)
+        {
+            records += (i == 0 ? ""s : ",\n  "s) + R"({"id": )"s + std::to_string(i) + R"(, "name": "record \"\u0041\"", "values": [1.5e3, null, true]})"s;
+        }
+        records += "]"s;
+        const size_t allocations_before = allocation_count;
+        assert(Validate(records).IsValid());
+        assert(!Validate(std::string_view(records).substr(0, records.size() - 1)).IsValid());
+        assert(allocation_count == allocations_before);
+    }
+
+    template <typename Fn>
+    void PrintDuration(std::string_view label, Fn fn)
+    {
+        const size_t allocations_before = allocation_count;
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto duration = std::chrono::steady_clock::now() - start;
+        std::cout << label << ": "sv << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << "ms, "sv
+                  << allocation_count - allocations_before << " allocations"sv << std::endl;
+    }
+
+    // Много поисков по ключу в объектах разного размера
+    void BenchmarkLookup()
+    {
+        for (int size : {8, 64, 1'000})
+        {
+            std::map<std::string, Node> tree;
+            Dict::Entries entries;
+            std::vector<std::string> keys;
+            for (int i = 0; i < size; ++i)
+            {
+                keys.push_back("some_object_key_"s + std::to_string(i));
+                tree.emplace(keys.back(), i);
+                entries.emplace_back(keys.back(), i);
+            }
+            const Dict dict(std::move(entries));
+            const int rounds = 1'000'000 / size;
+
+            long long sum = 0;
+            PrintDuration("std::map lookups, size "s + std::to_string(size), [&]
+                          {
+                              for (int round = 0; round < rounds; ++round)
+                              {
+                                  for (const std::string &key : keys)
+                                  {
+                                      sum += tree.at(key).AsInt();
+                                  }
+                              } });
+            PrintDuration("Dict lookups, size "s + std::to_string(size), [&]
+                          {
+                              for (int round = 0; round < rounds; ++round)
+                              {
+                                  for (const std::string &key : keys)
+                                  {
+                                      sum -= dict.at(key).AsInt();
+                                  }
+                              } });
+            assert(sum == 0);
+        }
+
+        // Словарь, собранный по одному ключу: каждая вставка сдвигает пары и номера в индексе
+        for (int size : {1'000, 10'000})
+        {
+            std::vector<std::string> keys;
+            for (int i = 0; i < size; ++i)
+            {
+                keys.push_back("some_object_key_"s + std::to_string(i));
+            }
+            std::map<std::string, Node> tree;
+            PrintDuration("std::map inserts, size "s + std::to_string(size), [&]
+                          {
+                              for (int i = 0; i < size; ++i)
+                              {
+                                  tree[keys[i]] = i;
+                              } });
+            Dict dict;
+            PrintDuration("Dict inserts, size "s + std::to_string(size), [&]
+                          {
+                              for (int i = 0; i < size; ++i)
+                              {
+                                  dict[keys[i]] = i;
+                              } });
+            assert(dict.size() == tree.size());
+        }
+    }
+
+    // Из широких объектов читается лишь несколько полей
+    void BenchmarkLazy()
+    {
+        std::string text = "["s;
+        for (int i = 0; i < 1'000; ++i)
+        {
+            text += i == 0 ? "{"s : ", {"s;
+            for (int field = 0; field < 200; ++field)
+            {
+                text += "\"field_"s + std::to_string(field) + "\": "s;
+                text += field % 2 == 0 ? std::to_string(field * i) : "\"value "s + std::to_string(field) + "\""s;
+                text += ", "s;
+            }
+            text += "\"id\": "s + std::to_string(i) + ", \"tags\": [\"a\", \"b\"]}"s;
+        }
+        text += "]"s;
+
+        long long sum = 0;
+        PrintDuration("Load, 3 of 202 fields"sv, [&]
+                      {
+                          const Document doc = Load(text);
+                          for (const Node &item : doc.GetRoot().AsArray())
+                          {
+                              const Dict &dict = item.AsMap();
+                              sum += dict.at("id"sv).AsInt() + dict.at("field_10"sv).AsInt() + static_cast<long long>(dict.at("tags"sv).AsArray().size());
+                          } });
+        PrintDuration("LoadLazy, 3 of 202 fields"sv, [&]
+                      {
+                          const LazyDocument doc = LoadLazy(text);
+                          for (const LazyNode &item : doc.GetRoot().AsArray())
+                          {
+                              sum -= item["id"sv].AsInt() + item["field_10"sv].AsInt() + static_cast<long long>(item["tags"sv].AsArray().size());
+                          } });
+        assert(sum == 0);
+
+        const Path path("$[*].field_10"sv);
+        std::vector<LazyNode> selected;
+        selected.reserve(1'000);
+        PrintDuration("LoadLazy, Path $[*].field_10"sv, [&]
+                      {
+                          selected.clear();
+                          path.Select(LoadLazy(text).GetRoot(), selected);
+                          assert(selected.size() == 1'000); });
+
+        // Снимок открывается без разбора, время открытия не зависит от размера
+        const TempFile file{SaveSnapshot(Load(text))};
+        PrintDuration("LoadSnapshotFile, 3 of 202 fields"sv, [&]
+                      {
+                          const SnapshotDocument doc = LoadSnapshotFile(file.GetPath());
+                          for (const SnapshotNode &item : doc.GetRoot().AsArray())
+                          {
+                              sum += item["id"sv].AsInt() + item["field_10"sv].AsInt() + static_cast<long long>(item["tags"sv].AsArray().size());
+                          } });
+        PrintDuration("LoadSnapshotFile, open only"sv, [&]
+                      { assert(LoadSnapshotFile(file.GetPath()).GetRoot().IsArray()); });
+        assert(sum > 0);
+    }
+
+    // Разбор JSON Lines на разном числе потоков
+    void BenchmarkLines()
+    {
+        const std::string record = R"({"int": 42, "double": 42.1, "null": null, "string": "hello", "array": [1, 2, 3], "bool": true, "map": {"key": "value"}})"s;
+        const size_t records = 50'000;
+        std::string text;
+        text.reserve((record.size() + 1) * records);
+        for (size_t i = 0; i < records; ++i)
+        {
+            text += record;
+            text += '\n';
+        }
+        std::vector<size_t> thread_counts{1, 2, 4};
+        if (std::thread::hardware_concurrency() > 4)
+        {
+            thread_counts.push_back(std::thread::hardware_concurrency());
+        }
+        for (size_t threads : thread_counts)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            assert(LoadLines(text, {}, threads).size() == records);
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+            std::cout << "LoadLines, "sv << threads << " threads: "sv << static_cast<size_t>(records / duration.count()) << " records/s"sv << std::endl;
+        }
+    }
+
+    void Benchmark()
+    {
+        Array arr;
+        arr.reserve(1'000);
+        for (int i = 0; i < 1'000; ++i)
+        {
+            arr.emplace_back(Dict{
+                {"int"s, 42},
+                {"double"s, 42.1},
+                {"null"s, nullptr},
+                {"string"s, "hello"s},
+                {"array"s, Array{1, 2, 3}},
+                {"bool"s, true},
+                {"map"s, Dict{{"key"s, "value"s}}},
+            });
+        }
+        std::stringstream strm;
+        json::Print(Document{arr}, strm);
+        const std::string text = strm.str();
+        const Node expected{arr};
+
+        // Сборка тех же записей: литералами Array и Dict, через Builder и сразу в текст
+        PrintDuration("Build(Array/Dict literals)"sv, [&]
+                      {
+                          Array records;
+                          records.reserve(1'000);
+                          for (int i = 0; i < 1'000; ++i)
+                          {
+                              records.emplace_back(Dict{
+                                  {"int"s, 42},
+                                  {"double"s, 42.1},
+                                  {"null"s, nullptr},
+                                  {"string"s, "hello"s},
+                                  {"array"s, Array{1, 2, 3}},
+                                  {"bool"s, true},
+                                  {"map"s, Dict{{"key"s, "value"s}}},
+                              });
+                          }
+                          assert(Node{move(records)} == expected); });
+        PrintDuration("Build(Builder)"sv, [&]
+                      {
+                          Builder builder;
+                          builder.StartArray(1'000);
+                          for (int i = 0; i < 1'000; ++i)
+                          {
+                              BuildRecord(builder);
+                          }
+                          assert(builder.EndArray().Build() == expected); });
+        {
+            std::string buffer;
+            Writer writer(buffer);
+            PrintDuration("Build(Builder into Writer)"sv, [&]
+                          {
+                              writer.Clear();
+                              Builder builder(writer);
+                              builder.StartArray();
+                              for (int i = 0; i < 1'000; ++i)
+                              {
+                                  BuildRecord(builder);
+                              }
+                              builder.EndArray();
+                              assert(buffer.size() > text.size() / 2); });
+        }
+
+        PrintDuration("Load(istream)"sv, [&]
+                      {
+                          std::istringstream input(text);
+                          const auto doc = json::Load(input);
+                          assert(doc.GetRoot() == expected); });
+        PrintDuration("Load(string_view)"sv, [&]
+                      {
+                          const auto doc = json::Load(std::string_view(text));
+                          assert(doc.GetRoot() == expected); });
+
+        PrintDuration("Validate"sv, [&]
+                      { assert(json::Validate(text).IsValid()); });
+
+        PrintDuration("Load(string_view, use_arena)"sv, [&]
+                      {
+                          LoadOptions options;
+                          options.use_arena = true;
+                          const auto doc = json::Load(std::string_view(text), options);
+                          assert(doc.GetRoot() == expected); });
+
+        PrintDuration("Load(string_view, use_structural_index)"sv, [&]
+                      {
+                          LoadOptions options;
+                          options.use_structural_index = true;
+                          const auto doc = json::Load(std::string_view(text), options);
+                          assert(doc.GetRoot() == expected); });
+        {
+            // Сто версий документа, в каждой изменено одно поле одной записи
+            const Document base = json::Load(std::string_view(text));
+            PrintDuration("100 edited copies(copy-on-write)"sv, [&]
+                          {
+                              std::vector<Document> versions;
+                              versions.reserve(100);
+                              for (int i = 0; i < 100; ++i)
+                              {
+                                  Document version = base;
+                                  version.GetMutableRoot().AsMutableArray()[i].AsMutableMap()["int"sv] = i;
+                                  versions.push_back(std::move(version));
+                              }
+                              assert(base.GetRoot() == expected); });
+        }
+        PrintDuration("Parse(SAX)"sv, [&]
+                      {
+                          // Обработчик только считает значения, документ не строится
+                          struct CountingHandler : Handler
+                          {
+                              void OnInt(int64_t) override { ++values; }
+                              void OnDouble(double) override { ++values; }
+                              void OnString(std::string_view) override { ++values; }
+                              size_t values = 0;
+                          } handler;
+                          Parse(text, handler);
+                          assert(handler.values == 7'000); });
+        for (auto [backend, name] : {std::pair{ScanBackend::Scalar, "scalar"sv}, std::pair{ScanBackend::Sse2, "SSE2"sv}, std::pair{ScanBackend::Avx2, "AVX2"sv}})
+        {
+            if (backend > GetScanBackend())
+            {
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const size_t positions = BuildStructuralIndex(text, backend).size();
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+            std::cout << "Structural index ("sv << name << "): "sv << positions << " positions, "sv
+                      << text.size() / duration.count() / 1'000'000 << " MB/s"sv << std::endl;
+        }
+
+        // Телеметрия: почти одни числа, в том числе большие целые
+        std::string numbers = "["s;
+        for (int i = 0; i < 100'000; ++i)
+        {
+            numbers += std::to_string(i * 1'000'003LL) + ", "s + std::to_string(i * 12'345'678'901LL) + ", "s + std::to_string(i * 0.001) + ", "s;
+        }
+        numbers += "0]"s;
+        PrintDuration("Load(numbers)"sv, [&]
+                      { assert(json::Load(numbers).GetRoot().AsArray().size() == 300'001); });
+        for (size_t threads : {2, 4})
+        {
+            LoadOptions options;
+            options.threads = threads;
+            PrintDuration("Load(numbers), "s + std::to_string(threads) + " threads"s, [&]
+                          { assert(json::Load(numbers, options).GetRoot().AsArray().size() == 300'001); });
+        }
+
+        // Тексты: длинные строки, изредка с escape-последовательностями
+        std::string strings = "["s;
+        for (int i = 0; i < 20'000; ++i)
+        {
+            strings += "\"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "s;
+            strings += i % 10 == 0 ? "\\u00e9\\n\", "s : "incididunt\", "s;
+        }
+        strings += "\"\"]"s;
+        PrintDuration("Load(strings)"sv, [&]
+                      { assert(json::Load(strings).GetRoot().AsArray().size() == 20'001); });
+
+        const MemoryUsage usage = json::Load(text).GetMemoryUsage();
+        std::cout << "Memory: "sv << usage.nodes << " nodes, "sv << usage.GetTotalBytes() << " bytes ("sv
+                  << usage.node_bytes << " in nodes, "sv << usage.container_bytes << " in containers, "sv
+                  << usage.string_bytes << " in strings)"sv << std::endl;
+
+        {
+            // Записи с длинными повторяющимися ключами, как в выгрузках логов
+            std::string records = "["s;
+            for (int i = 0; i < 20'000; ++i)
+            {
+                records += "{\"request_identifier\": "s + std::to_string(i) + ", \"response_status_code\": 200, \"upstream_latency_ms\": 1.5},"s;
+            }
+            records += "{}]"s;
+            PrintDuration("Load(records)"sv, [&]
+                          { assert(json::Load(records).GetRoot().AsArray().size() == 20'001); });
+            LoadOptions options;
+            options.intern_keys = true;
+            PrintDuration("Load(records, intern_keys)"sv, [&]
+                          { assert(json::Load(records, options).GetRoot().AsArray().size() == 20'001); });
+            const MemoryUsage interned_usage = json::Load(records, options).GetMemoryUsage();
+            std::cout << "Interned keys: "sv << interned_usage.interned_keys << " keys, "sv
+                      << interned_usage.interned_bytes_saved << " bytes saved, "sv << interned_usage.GetTotalBytes() << " bytes total vs "sv
+                      << json::Load(records).GetMemoryUsage().GetTotalBytes() << std::endl;
+        }
+
+        BenchmarkLookup();
+        BenchmarkLazy();
+        BenchmarkLines();
+
+        PrintDuration("Print(ostream)"sv, [&]
+                      {
+                          std::ostringstream out;
+                          json::Print(Document{expected}, out);
+                          assert(out.str() == text); });
+        {
+            const Document numbers_doc = Load(numbers);
+            for (size_t threads : {1, 2, 4})
+            {
+                PrintOptions options;
+                options.threads = threads;
+                PrintDuration("ToString(numbers), "s + std::to_string(threads) + " threads"s, [&]
+                              { assert(ToString(numbers_doc, options).size() > numbers.size() / 2); });
+            }
+        }
+        std::string buffer;
+        Writer writer(buffer);
+        writer.WriteNode(expected);
+        PrintDuration("Writer(reused buffer)"sv, [&]
+                      {
+                          writer.Clear();
+                          writer.WriteNode(expected);
+                          assert(buffer == text); });
+
+        {
+            // Обмен между сервисами: тот же документ текстом и в MessagePack
+            const Document doc{expected};
+            const std::string binary = SaveBinary(doc);
+            std::cout << "Size: text "sv << text.size() << " bytes, binary "sv << binary.size() << " bytes"sv << std::endl;
+            std::string binary_buffer = binary;
+            PrintDuration("SaveBinary(reused buffer)"sv, [&]
+                          {
+                              binary_buffer.clear();
+                              SaveBinary(doc, binary_buffer);
+                              assert(binary_buffer == binary); });
+            PrintDuration("LoadBinary"sv, [&]
+                          { assert(LoadBinary(binary).GetRoot() == expected); });
+            const Document numbers_doc = Load(numbers);
+            const std::string numbers_binary = SaveBinary(numbers_doc);
+            std::cout << "Size: numbers text "sv << numbers.size() << " bytes, binary "sv << numbers_binary.size() << " bytes"sv << std::endl;
+            PrintDuration("SaveBinary(numbers)"sv, [&]
+                          { assert(SaveBinary(numbers_doc).size() == numbers_binary.size()); });
+            PrintDuration("LoadBinary(numbers)"sv, [&]
+                          { assert(LoadBinary(numbers_binary).GetRoot().AsArray().size() == 300'001); });
+        }
+
+        const TempFile file{text};
+        PrintDuration("LoadFile"sv, [&]
+                      {
+                          const auto doc = json::LoadFile(file.GetPath());
+                          assert(doc.GetRoot() == expected); });
+        PrintDuration("LoadFile(borrow_strings)"sv, [&]
+                      {
+                          LoadOptions options;
+                          options.borrow_strings = true;
+                          const auto doc = json::LoadFile(file.GetPath(), options);
+                          assert(doc.GetRoot() == expected); });
     }
 
 } // namespace
@@ -280,10 +2527,32 @@ int main()
 {
     TestNull();
     TestNumbers();
+    TestLargeNumbers();
     TestStrings();
     TestBool();
     TestArray();
     TestMap();
     TestErrorHandling();
+    TestLoadFile();
+    TestArena();
+    TestDict();
+    TestCompactNode();
+    TestStructuralIndex();
+    TestSax();
+    TestWriter();
+    TestLazy();
+    TestLines();
+    TestParallelArray();
+    TestParallelPrint();
+    TestInternKeys();
+    TestBinary();
+    TestSnapshot();
+    TestPath();
+    TestIncremental();
+    TestDepth();
+    TestStats();
+    TestBuilder();
+    TestCopyOnWrite();
+    TestValidate();
     Benchmark();
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace json
+{
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file "s + path);
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+
+    MappedFile::~MappedFile() = default;
+#else
+    MappedFile::MappedFile(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open file "s + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file "s + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        // Пустой файл отобразить нельзя, он просто остаётся пустым буфером
+        if (size_ > 0)
+        {
+            void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to map file "s + path);
+            }
+            // Файл читается от начала до конца, подсказываем это ядру
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(data);
+        }
+        // Отображение остаётся валидным и после закрытия дескриптора
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data_ != nullptr)
+        {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+    }
+#endif
+
+    std::string_view MappedFile::GetData() const
+    {
+        return {data_, size_};
+    }
+
+} // namespace json
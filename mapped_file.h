@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace json
+{
+    // Файл, отображённый в память только для чтения.
+    // Там, где mmap недоступен, содержимое файла просто вычитывается в буфер
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        std::string_view GetData() const;
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        std::string buffer_;
+#endif
+    };
+
+} // namespace json
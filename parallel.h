@@ -0,0 +1,91 @@
+#pragma once
+
+// Внутренняя часть библиотеки: простое распределение независимых задач по потокам
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace json
+{
+    namespace detail
+    {
+        // Число потоков по умолчанию: столько, сколько ядер, но не меньше одного
+        inline size_t GetDefaultThreadCount()
+        {
+            return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        // Выполняет task(0), ..., task(count - 1) не более чем на threads потоках, включая вызывающий.
+        // Потоки сами забирают следующую задачу, поэтому задачи разной длины распределяются ровно.
+        // После первого исключения новые задачи не начинаются, а само исключение пробрасывается,
+        // когда завершатся все потоки
+        template <typename Task>
+        void ParallelFor(size_t count, size_t threads, const Task &task)
+        {
+            threads = std::min(threads, count);
+            if (threads <= 1)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    task(i);
+                }
+                return;
+            }
+
+            std::atomic<size_t> next{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+            std::mutex error_mutex;
+            const auto worker = [&]
+            {
+                for (size_t i = next++; i < count && !failed; i = next++)
+                {
+                    try
+                    {
+                        task(i);
+                    }
+                    catch (...)
+                    {
+                        const std::lock_guard lock(error_mutex);
+                        if (!error)
+                        {
+                            error = std::current_exception();
+                        }
+                        failed = true;
+                    }
+                }
+            };
+
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            try
+            {
+                for (size_t i = 1; i < threads; ++i)
+                {
+                    pool.emplace_back(worker);
+                }
+            }
+            catch (const std::system_error &)
+            {
+                // Обходимся теми потоками, которые удалось запустить
+            }
+            worker();
+            for (std::thread &thread : pool)
+            {
+                thread.join();
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+    } // namespace detail
+
+} // namespace json
@@ -0,0 +1,314 @@
+#include "structural_index.h"
+#include "json.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSON_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JSON_TARGET(isa) __attribute__((target(isa)))
+#else
+#define JSON_TARGET(isa)
+#endif
+
+using namespace std;
+
+namespace json
+{
+    namespace
+    {
+        constexpr size_t kBlockSize = 64;
+
+        // Битовые маски одного блока: i-й бит соответствует i-му байту
+        struct BlockMasks
+        {
+            uint64_t quote = 0;
+            uint64_t backslash = 0;
+            uint64_t structural = 0;
+            uint64_t whitespace = 0;
+        };
+
+        int CountTrailingZeros(uint64_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(value);
+#endif
+        }
+
+        // Префиксный XOR: бит i результата - чётность числа единиц в битах 0..i
+        uint64_t PrefixXor(uint64_t bits)
+        {
+            bits ^= bits << 1;
+            bits ^= bits << 2;
+            bits ^= bits << 4;
+            bits ^= bits << 8;
+            bits ^= bits << 16;
+            bits ^= bits << 32;
+            return bits;
+        }
+
+        BlockMasks ClassifyScalar(const char *block)
+        {
+            BlockMasks masks;
+            for (size_t i = 0; i < kBlockSize; ++i)
+            {
+                const uint64_t bit = uint64_t{1} << i;
+                switch (block[i])
+                {
+                case '"':
+                    masks.quote |= bit;
+                    break;
+                case '\\':
+                    masks.backslash |= bit;
+                    break;
+                case '{':
+                case '}':
+                case '[':
+                case ']':
+                case ':':
+                case ',':
+                    masks.structural |= bit;
+                    break;
+                case ' ':
+                case '\t':
+                case '\n':
+                case '\v':
+                case '\f':
+                case '\r':
+                    masks.whitespace |= bit;
+                    break;
+                default:
+                    break;
+                }
+            }
+            return masks;
+        }
+
+#ifdef JSON_SCAN_X86
+        JSON_TARGET("sse2")
+        uint64_t MatchSse2(__m128i chunk, char c)
+        {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))));
+        }
+
+        // Пробельные символы те же, что у detail::IsSpace: пробел и коды 9-13
+        JSON_TARGET("sse2")
+        uint64_t MatchSpaceSse2(__m128i chunk)
+        {
+            const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('\r' + 1)));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')))));
+        }
+
+        JSON_TARGET("sse2")
+        BlockMasks ClassifySse2(const char *block)
+        {
+            BlockMasks masks;
+            for (size_t offset = 0; offset < kBlockSize; offset += 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + offset));
+                masks.quote |= MatchSse2(chunk, '"') << offset;
+                masks.backslash |= MatchSse2(chunk, '\\') << offset;
+                masks.structural |= (MatchSse2(chunk, '{') | MatchSse2(chunk, '}') | MatchSse2(chunk, '[') | MatchSse2(chunk, ']') | MatchSse2(chunk, ':') | MatchSse2(chunk, ',')) << offset;
+                masks.whitespace |= MatchSpaceSse2(chunk) << offset;
+            }
+            return masks;
+        }
+
+        JSON_TARGET("avx2")
+        uint64_t MatchAvx2(__m256i chunk, char c)
+        {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c))));
+        }
+
+        JSON_TARGET("avx2")
+        uint64_t MatchSpaceAvx2(__m256i chunk)
+        {
+            const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), chunk));
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(control, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')))));
+        }
+
+        JSON_TARGET("avx2")
+        BlockMasks ClassifyAvx2(const char *block)
+        {
+            BlockMasks masks;
+            for (size_t offset = 0; offset < kBlockSize; offset += 32)
+            {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + offset));
+                masks.quote |= MatchAvx2(chunk, '"') << offset;
+                masks.backslash |= MatchAvx2(chunk, '\\') << offset;
+                masks.structural |= (MatchAvx2(chunk, '{') | MatchAvx2(chunk, '}') | MatchAvx2(chunk, '[') | MatchAvx2(chunk, ']') | MatchAvx2(chunk, ':') | MatchAvx2(chunk, ',')) << offset;
+                masks.whitespace |= MatchSpaceAvx2(chunk) << offset;
+            }
+            return masks;
+        }
+
+        bool CpuSupportsAvx2()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+            __cpuid(info, 1);
+            // ОС должна сохранять YMM-регистры при переключении контекста
+            const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+
+        bool CpuSupportsSse2()
+        {
+#if defined(_MSC_VER) || defined(__x86_64__)
+            return true;
+#else
+            return __builtin_cpu_supports("sse2");
+#endif
+        }
+#endif
+
+        BlockMasks Classify(const char *block, ScanBackend backend)
+        {
+#ifdef JSON_SCAN_X86
+            switch (backend)
+            {
+            case ScanBackend::Avx2:
+                return ClassifyAvx2(block);
+            case ScanBackend::Sse2:
+                return ClassifySse2(block);
+            case ScanBackend::Scalar:
+                break;
+            }
+#else
+            (void)backend;
+#endif
+            return ClassifyScalar(block);
+        }
+
+        // Состояние, которое переходит из блока в блок
+        class StructuralScanner
+        {
+        public:
+            // Маска значимых позиций блока
+            uint64_t Next(const BlockMasks &masks)
+            {
+                const uint64_t escaped = FindEscaped(masks.backslash);
+                const uint64_t quote = masks.quote & ~escaped;
+                // Бит установлен от открывающей кавычки включительно до закрывающей исключительно
+                const uint64_t in_string = PrefixXor(quote) ^ prev_in_string_;
+                prev_in_string_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+                // Первые символы чисел и литералов: не пробел, не кавычка и не структурный символ,
+                // перед которым стоит пробел или структурный символ
+                const uint64_t scalar = ~(masks.structural | masks.whitespace | masks.quote);
+                const uint64_t follows_scalar = (scalar << 1) | prev_scalar_;
+                prev_scalar_ = scalar >> 63;
+                const uint64_t atom_starts = scalar & ~follows_scalar;
+
+                return ((masks.structural | atom_starts) & ~in_string) | (quote & in_string);
+            }
+
+            bool InString() const
+            {
+                return prev_in_string_ != 0;
+            }
+
+        private:
+            // Символы, перед которыми стоит нечётное число обратных косых черт
+            uint64_t FindEscaped(uint64_t backslash)
+            {
+                backslash &= ~prev_escaped_;
+                const uint64_t follows_escape = (backslash << 1) | prev_escaped_;
+                constexpr uint64_t even_bits = 0x5555555555555555ULL;
+                const uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+                const uint64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+                // Перенос из старшего разряда значит, что последовательность продолжается в следующем блоке
+                prev_escaped_ = sequences_starting_on_even_bits < odd_sequence_starts ? 1 : 0;
+                const uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+                return (even_bits ^ invert_mask) & follows_escape;
+            }
+
+            uint64_t prev_escaped_ = 0;
+            uint64_t prev_in_string_ = 0;
+            uint64_t prev_scalar_ = 0;
+        };
+
+        void AppendPositions(uint64_t bits, uint32_t base, std::vector<uint32_t> &positions)
+        {
+            while (bits != 0)
+            {
+                positions.push_back(base + static_cast<uint32_t>(CountTrailingZeros(bits)));
+                bits &= bits - 1;
+            }
+        }
+
+    } // namespace
+
+    ScanBackend GetScanBackend()
+    {
+        static const ScanBackend backend = []
+        {
+#ifdef JSON_SCAN_X86
+            if (CpuSupportsAvx2())
+            {
+                return ScanBackend::Avx2;
+            }
+            if (CpuSupportsSse2())
+            {
+                return ScanBackend::Sse2;
+            }
+#endif
+            return ScanBackend::Scalar;
+        }();
+        return backend;
+    }
+
+    std::vector<uint32_t> BuildStructuralIndex(std::string_view input)
+    {
+        return BuildStructuralIndex(input, GetScanBackend());
+    }
+
+    std::vector<uint32_t> BuildStructuralIndex(std::string_view input, ScanBackend backend)
+    {
+        std::vector<uint32_t> positions;
+        // Значимых символов обычно заметно меньше, чем байтов
+        positions.reserve(input.size() / 4 + 1);
+
+        StructuralScanner scanner;
+        size_t offset = 0;
+        for (; offset + kBlockSize <= input.size(); offset += kBlockSize)
+        {
+            const BlockMasks masks = Classify(input.data() + offset, backend);
+            AppendPositions(scanner.Next(masks), static_cast<uint32_t>(offset), positions);
+        }
+        if (offset < input.size())
+        {
+            // Хвост дополняется пробелами до целого блока
+            char block[kBlockSize];
+            std::memset(block, ' ', kBlockSize);
+            std::memcpy(block, input.data() + offset, input.size() - offset);
+            const BlockMasks masks = Classify(block, backend);
+            AppendPositions(scanner.Next(masks), static_cast<uint32_t>(offset), positions);
+        }
+        if (scanner.InString())
+        {
+            throw ParsingError("String parsing error");
+        }
+        return positions;
+    }
+
+} // namespace json
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+    // Чем классифицируются символы на первом проходе
+    enum class ScanBackend
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    // Лучший набор инструкций, доступный на этом процессоре. Определяется один раз через CPUID
+    ScanBackend GetScanBackend();
+
+    // Первый проход двухфазного разбора. Просматривает вход блоками по 64 байта и возвращает
+    // позиции всех значимых символов вне строк: скобок, запятых, двоеточий, открывающих кавычек
+    // и первых символов чисел и литералов. Пробелы и содержимое строк в индекс не попадают.
+    // Бросает ParsingError, если строка не закрыта до конца входа.
+    // Позиции 32-битные, поэтому вход должен быть меньше 4 ГБ
+    std::vector<uint32_t> BuildStructuralIndex(std::string_view input);
+    std::vector<uint32_t> BuildStructuralIndex(std::string_view input, ScanBackend backend);
+
+} // namespace json